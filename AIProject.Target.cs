@@ -16,6 +16,6 @@ public class AIProjectTarget : TargetRules
 
 	private void RegisterModulesCreatedByRider()
 	{
-		ExtraModuleNames.AddRange(new string[] { "AISensingExtented" });
+		ExtraModuleNames.AddRange(new string[] { "AISensingExtented", "AISensingExtentedMass" });
 	}
 }
@@ -16,6 +16,6 @@ public class AIProjectEditorTarget : TargetRules
 
 	private void RegisterModulesCreatedByRider()
 	{
-		ExtraModuleNames.AddRange(new string[] { "AISensingExtented" });
+		ExtraModuleNames.AddRange(new string[] { "AISensingExtented", "AISensingExtentedMass" });
 	}
 }
@@ -0,0 +1,34 @@
+﻿#include "Actor/NavAwareDebugRenderer.h"
+
+#include "Component/NavAwareDebugRenderComponent.h"
+#include "EngineUtils.h"
+
+
+ANavAwareDebugRenderer::ANavAwareDebugRenderer()
+{
+	PrimaryActorTick.bCanEverTick = false;
+	SetCanBeDamaged(false);
+	
+	RenderComponent = CreateDefaultSubobject<UNavAwareDebugRenderComponent>(TEXT("RenderComponent"));
+	RootComponent = RenderComponent;
+}
+
+ANavAwareDebugRenderer* ANavAwareDebugRenderer::Get(UWorld* World)
+{
+	if (World == nullptr) return nullptr;
+	
+	for (TActorIterator<ANavAwareDebugRenderer> It(World); It; ++It)
+	{
+		if (IsValid(*It))
+		{
+			return *It;
+		}
+	}
+
+	FActorSpawnParameters SpawnParams;
+	SpawnParams.Name = TEXT("NavAwareDebugRenderer");
+	SpawnParams.NameMode = FActorSpawnParameters::ESpawnActorNameMode::Requested;
+	SpawnParams.ObjectFlags |= RF_Transient;
+	SpawnParams.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AlwaysSpawn;
+	return World->SpawnActor<ANavAwareDebugRenderer>(SpawnParams);
+}
@@ -4,9 +4,65 @@
 #include "AI/NavigationSystemBase.h"
 #include "NavMesh/RecastNavMesh.h"
 #include "StainMathLibrary.h"
+#include "Subsystem/NavAwareCacheSubsystem.h"
+#include "Subsystem/NavAwareSchedulerSubsystem.h"
+#include "NavAwareBakedData.h"
+#include "NavAwareEdgeGrid.h"
+#include "NavAwareEdgeStore.h"
+#include "NavAwareIncremental.h"
+#include "NavAwareEdgeFixture.h"
+#include "NavAwareStats.h"
+#include "Actor/NavAwareDebugRenderer.h"
+#include "Component/NavAwareDebugRenderComponent.h"
+#include "Perception/AISense_NavAwareness.h"
+#include "LatentActions.h"
+#include "Async/Async.h"
+#include "Misc/ScopedSlowTask.h"
+#include "Misc/PackageName.h"
+#include "EngineUtils.h"
+#include "Misc/ScopeExit.h"
+#include "VisualLogger/VisualLogger.h"
 
 DEFINE_LOG_CATEGORY(NavAware);
 
+#if NAVAWARE_WITH_TRACE
+static FAutoConsoleCommandWithWorld CmdNavAwareDumpTrace(
+	TEXT("NavAware.DumpTrace"),
+	TEXT("Formats the trace events of the last query of every NavAware actor in the world to the log"),
+	FConsoleCommandWithWorldDelegate::CreateLambda([](UWorld* World)
+	{
+		for (TActorIterator<ANavAwareEnhancedBase> It(World); It; ++It)
+		{
+			It->DumpLastQueryTrace();
+		}
+	}));
+#endif
+
+/*
+ * Latent action of FindNearestEdgesAsync, finishes once the owner has swapped in the result of the query it waits for
+ */
+class FNavAwareQueryLatentAction : public FPendingLatentAction
+{
+public:
+	FNavAwareQueryLatentAction(ANavAwareEnhancedBase* InOwner, uint32 InQuerySerial, const FLatentActionInfo& LatentInfo)
+		: Owner(InOwner), QuerySerial(InQuerySerial), ExecutionFunction(LatentInfo.ExecutionFunction), OutputLink(LatentInfo.Linkage), CallbackTarget(LatentInfo.CallbackTarget)
+	{
+	}
+
+	virtual void UpdateOperation(FLatentResponse& Response) override
+	{
+		const bool bFinished = !Owner.IsValid() || Owner->GetCompletedAsyncQuerySerial() >= QuerySerial;
+		Response.FinishAndTriggerIf(bFinished, ExecutionFunction, OutputLink, CallbackTarget);
+	}
+
+private:
+	TWeakObjectPtr<ANavAwareEnhancedBase> Owner;
+	uint32 QuerySerial;
+	FName ExecutionFunction;
+	int32 OutputLink;
+	FWeakObjectPtr CallbackTarget;
+};
+
 
 ANavAwareEnhancedBase::ANavAwareEnhancedBase()
 {
@@ -18,6 +74,29 @@ void ANavAwareEnhancedBase::BeginPlay()
 	Super::BeginPlay();
 }
 
+void ANavAwareEnhancedBase::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	//the worker task uses this actor's members, never let it outlive us
+	if (bAsyncQueryPending)
+	{
+		AsyncQueryTask.Wait();
+		bAsyncQueryPending = false;
+		ReleaseNavBuildLock();
+	}
+
+	if (UNavAwareSchedulerSubsystem* Scheduler = GetWorld()->GetSubsystem<UNavAwareSchedulerSubsystem>())
+	{
+		Scheduler->CancelRequest(this);
+	}
+
+	if (ANavAwareDebugRenderer* Renderer = DebugRenderer.Get())
+	{
+		Renderer->GetRenderComponent()->ClearAgent(this);
+	}
+	
+	Super::EndPlay(EndPlayReason);
+}
+
 void ANavAwareEnhancedBase::Tick(float DeltaTime)
 {
 	Super::Tick(DeltaTime);
@@ -25,380 +104,991 @@ void ANavAwareEnhancedBase::Tick(float DeltaTime)
 
 void ANavAwareEnhancedBase::FindNearestEdges(bool bDebug, float radius)
 {
+	//would wait for the worker's classification, and be overwritten by its older result after
+	if (bAsyncQueryPending)
+	{
+		UE_LOG(NavAware, Verbose, TEXT("%s: FindNearestEdges skipped, an async query is still in flight"), *GetName())
+		return;
+	}
+	
 	MainNavSystem = FNavigationSystem::GetCurrent<UNavigationSystemV1>(GetWorld());
 	if (MainNavSystem)
 	{
 		MainRecastNavMesh = Cast<ARecastNavMesh>(MainNavSystem->GetDefaultNavDataInstance());
-		const NavNodeRef NodeRef = MainRecastNavMesh->FindNearestPoly(GetActorLocation(), FVector(500.f, 500.f, 500.f));
-		TArray<FNavigationWallEdge> GetEdges;
+		SnapshotPipelineSettings();
 		
-		MainRecastNavMesh->FindEdges(NodeRef, GetActorLocation(), radius, MainNavSystem->CreateDefaultQueryFilterCopy(), GetEdges);
-		
-		GatherEdgesWithSorting(GetEdges, WallEdges, bDebug);
-		EdgeLinker(WallEdges);
-		MarkCorner(WallEdges);
-		FilterOnlyInnerEdge(WallEdges);
-		MarkEntryEdges(WallEdges);
-		MakeCornerArray(WallEdges, Corners);
-		TakeSteps(WallEdges, true);
+		const FVector Origin = GetActorLocation();
+		FNavAwareResult Result;
+		FNavAwareCacheKey CacheKey;
+		if (!FindCachedResult(Origin, radius, Result, CacheKey))
+		{
+			RunPipeline(Origin, radius, MainNavSystem->CreateDefaultQueryFilterCopy(), Result, GetIncrementalState(), GetNavSerial(), CacheKey.Poly);
+			StoreCachedResult(CacheKey, Origin, radius, Result);
+		}
+		ApplyResult(Result, bDebug);
 	}
 	else
 	{
 		UE_LOG(NavAware, Error, TEXT("No NavSystem availiable!"))
 	}
+}
+
+void ANavAwareEnhancedBase::FindNearestEdgesAsync(FLatentActionInfo LatentInfo, bool bDebug, float radius)
+{
+	UWorld* World = GetWorld();
+	if (World == nullptr) return;
 	
-	/*
-	 *Debugger*/
-	if (bDebug)
+	if (!bAsyncQueryPending)
 	{
-		for (const auto&  [Start, End, ID, LineID, Type, Degree, Prev, Next] : WallEdges)
+		MainNavSystem = FNavigationSystem::GetCurrent<UNavigationSystemV1>(World);
+		if (MainNavSystem == nullptr)
 		{
-			DrawDebugBox(GetWorld(), End, FVector(10.f, 10.f, 20.f), FColor::Red, false, 1.1f);
-			DrawDebugDirectionalArrow(GetWorld(), Start, End, 20.f, FColor::MakeRedToGreenColorFromScalar(LineID * 0.15f), false, 1.f, 0);
+			UE_LOG(NavAware, Error, TEXT("No NavSystem availiable!"))
+			return;
+		}
+		MainRecastNavMesh = Cast<ARecastNavMesh>(MainNavSystem->GetDefaultNavDataInstance());
+		SnapshotPipelineSettings();
+
+		const FVector Origin = GetActorLocation();
+		
+		//a cache hit is cheap enough to be swapped in right away
+		FNavAwareCacheKey CacheKey;
+		if (!MainNavSystem->IsNavigationBuildInProgress() && FindCachedResult(Origin, radius, BackBuffer, CacheKey))
+		{
+			++AsyncQuerySerial;
+			CompletedAsyncQuerySerial = AsyncQuerySerial;
+			ApplyResult(BackBuffer, bDebug);
+		}
+		//navmesh tiles are swapped on the game thread while building, don't read them from a worker at the same time.
+		//With no build running, the lock keeps a new one from starting until the worker is done
+		else if (MainNavSystem->IsNavigationBuildInProgress() || !AcquireNavBuildLock())
+		{
+			FindNearestEdges(bDebug, radius);
+			++AsyncQuerySerial;
+			CompletedAsyncQuerySerial = AsyncQuerySerial;
+		}
+		else
+		{
+			bAsyncQueryPending = true;
+			++AsyncQuerySerial;
 			
-			FString PrintString = FString::Printf(TEXT("[%d][%02d]Deg: %.2f, Length: %.2f"), LineID, ID, Degree, (End - Start).Length());
-			DrawDebugString(GetWorld(), End + FVector(0.f,0.f,0.f), PrintString, 0, FColor::White, 1.f, false, 1.f);
+			FSharedConstNavQueryFilter QueryFilter = MainNavSystem->CreateDefaultQueryFilterCopy();
+			FNavAwareIncrementalState* Incremental = GetIncrementalState();
+			const uint32 NavSerial = GetNavSerial();
+			const uint32 AreaSerial = GetAreaSerial(Origin, radius, CacheKey.TileIndex);
+			TWeakObjectPtr<ANavAwareEnhancedBase> WeakThis(this);
 			
-			if (Type == EWallType::Corner)
+			//EndPlay waits for the task, the worker itself only reads QuerySettings, which stays put until it is done
+			AsyncQueryTask = UE::Tasks::Launch(UE_SOURCE_LOCATION, [this, WeakThis, Origin, radius, QueryFilter, Incremental, NavSerial, AreaSerial, bDebug, CacheKey]()
 			{
-				DrawDebugSphere(GetWorld(), End, 20.f, 8, FColor::Cyan, false, 1.f);
-			}
-			else if (Type == EWallType::Entry)
-			{
-				DrawDebugSphere(GetWorld(), End, 20.f, 8, FColor::Purple, false, 1.f);
-			}
-			if (bShowLog)
-			{
-				//prints out all elements
-				uint8 PrevID = 0;
-				uint8 NextID = 0;
-				if (Prev) PrevID = Prev->EdgeID;
-				if (Next) NextID = Next->EdgeID;
+				RunPipeline(Origin, radius, QueryFilter, BackBuffer, Incremental, NavSerial, CacheKey.Poly);
 				
-				UE_LOG(NavAware, Display,
-                    TEXT("[Start: [%04.1f, %04.1f], End: [%04.1f, %04.1f], ID: %02d, LineID: %d, Type: %d, Degree: %.2f, Prev: [%02d], Next: [%02d]]"),
-                    Start.X, Start.Y, End.X, End.Y, ID, LineID, Type, Degree, PrevID, NextID)
-			}
+				AsyncTask(ENamedThreads::GameThread, [WeakThis, bDebug, Origin, radius, AreaSerial, CacheKey]()
+				{
+					if (ANavAwareEnhancedBase* StrongThis = WeakThis.Get())
+					{
+						StrongThis->OnAsyncQueryFinished(bDebug, Origin, radius, AreaSerial, CacheKey);
+					}
+				});
+			});
 		}
-		for (const auto& [Start, End, ID] : Corners)
+	}
+	
+	FLatentActionManager& LatentManager = World->GetLatentActionManager();
+	if (LatentManager.FindExistingAction<FNavAwareQueryLatentAction>(LatentInfo.CallbackTarget, LatentInfo.UUID) == nullptr)
+	{
+		LatentManager.AddNewAction(LatentInfo.CallbackTarget, LatentInfo.UUID, new FNavAwareQueryLatentAction(this, AsyncQuerySerial, LatentInfo));
+	}
+}
+
+void ANavAwareEnhancedBase::RequestAwarenessUpdate(float Urgency, bool bDebug, float radius)
+{
+	if (UNavAwareSchedulerSubsystem* Scheduler = GetWorld()->GetSubsystem<UNavAwareSchedulerSubsystem>())
+	{
+		Scheduler->EnqueueRequest(this, Urgency, radius, bDebug);
+	}
+	else
+	{
+		//no scheduler in this world type, e.g. editor preview
+		FindNearestEdges(bDebug, radius);
+	}
+}
+
+void ANavAwareEnhancedBase::RunPipeline(const FVector& Origin, float Radius, FSharedConstNavQueryFilter QueryFilter, FNavAwareResult& OutResult,
+	FNavAwareIncrementalState* Incremental, uint32 NavSerial, NavNodeRef StartPoly)
+{
+	NAVAWARE_SCOPE(Pipeline);
+	
+#if NAVAWARE_WITH_TRACE
+	//one buffer per thread, keeps its allocation between queries
+	static thread_local FNavAwareTraceBuffer QueryTrace;
+	FNavAwareTraceScope TraceScope(QueryTrace);
+	ON_SCOPE_EXIT
+	{
+		//swapped, not copied: the thread's buffer takes the older allocation and is reset by the next scope
+		FScopeLock TraceLock(&LastQueryTraceSection);
+		Swap(LastQueryTrace, QueryTrace);
+	};
+#endif
+	
+	OutResult.Reset();
+	const ARecastNavMesh* NavMesh = QuerySettings.NavMesh;
+	if (NavMesh == nullptr) return;
+	INC_DWORD_STAT(STAT_NavAware_Queries);
+	
+	TArray<FNavigationWallEdge> GetEdges;
+	{
+		NAVAWARE_SCOPE(FindEdges);
+		NavNodeRef NodeRef = StartPoly;
+		if (NodeRef == INVALID_NAVNODEREF)
 		{
-			if (bShowLog)
-			{
-				UE_LOG(NavAware, Display, TEXT("Corner[%d]: Start: %02d, End: %02d"), ID, Start->EdgeID, End->EdgeID)
-			}
-			
-			FNavPoint* DrawingEdge = Start;
-			while (true)
-			{
-				DrawDebugDirectionalArrow(GetWorld(), DrawingEdge->Start, DrawingEdge->End, 10.f, FColor::Purple, false, 1.3, 0, 5.f);
-				if (DrawingEdge == End) break;
-				DrawingEdge = DrawingEdge->NextEdge;
-			}
-			
-			DrawDebugBox(GetWorld(), Start->Start, FVector(5.f, 5.f, 50.f), FColor::Green, false, 1.f);
-			DrawDebugBox(GetWorld(), End->End, FVector(5.f, 5.f, 50.f), FColor::Green, false, 1.f);
+			NodeRef = NavMesh->FindNearestPoly(Origin, FVector(500.f, 500.f, 500.f));
+			INC_DWORD_STAT(STAT_NavAware_FindNearestPolyCalls);
 		}
-		for (const auto& Entry : Entries)
+		
+		NavMesh->FindEdges(NodeRef, Origin, Radius, QueryFilter, GetEdges);
+	}
+
+	ClassifyEdges(GetEdges, Origin, Radius, OutResult, Incremental, NavSerial);
+}
+
+void ANavAwareEnhancedBase::ClassifyEdges(TArray<FNavigationWallEdge>& InEdges, const FVector& Origin, float Radius, FNavAwareResult& OutResult,
+	FNavAwareIncrementalState* Incremental, uint32 NavSerial)
+{
+	//every stage works on the store, only the final result is turned into FNavPoints
+	FNavAwareEdgeStore Edges;
+	GatherEdgesWithSorting(InEdges, Origin, Edges);
+	EdgeLinker(Edges);
+#if STATS
+	const int32 NumLines = Edges.NumLines();
+	INC_DWORD_STAT_BY(STAT_NavAware_Edges, Edges.Num());
+	INC_DWORD_STAT_BY(STAT_NavAware_Lines, NumLines);
+	SET_DWORD_STAT(STAT_NavAware_QueryEdges, Edges.Num());
+	SET_DWORD_STAT(STAT_NavAware_QueryLines, NumLines);
+#endif
+
+	//only one query at a time may diff against and replace the incremental state
+	FScopeLock Lock(&IncrementalSection);
+	
+	const uint32 SettingsHash = QuerySettings.SettingsHash;
+	const bool bDiffed = Incremental && Incremental->Matches(Radius, SettingsHash, NavSerial);
+	FNavAwareEdgeDiff Diff;
+	if (bDiffed)
+	{
+		NAVAWARE_SCOPE(EdgeDiff);
+		Diff.Build(Incremental->Edges, Edges, QuerySettings.EdgeWeldTolerance);
+		
+		//lines left untouched keep their classification
+		for (int32 i = 0; i < Edges.Num(); i++)
 		{
-			DrawDebugDirectionalArrow(GetWorld(), Entry.Start, Entry.End, 5.f, FColor::Green, false, 1.f);
-			DrawDebugDirectionalArrow(GetWorld(), Entry.Start, GetPerpendicularLineFromPointOnEdgeInPolySide(Entry.Start, *Entry.EdgeA), 5.f, FColor::Yellow, false, 1.f);
-			
-			if (bShowLog)
+			const int32 OldEdge = Diff.GetOldEdge(i);
+			if (OldEdge != INDEX_NONE)
 			{
-				UE_LOG(NavAware, Display, TEXT("Entry: CornerEdge: [%02d], TargetEdge: [%02d], width: %.1f, LineA: %d, LineB: %d"), Entry.EdgeA->EdgeID, Entry.EdgeB->EdgeID, Entry.Width, *Entry.CurrentLineID, *Entry.TargetLineID)
+				Edges.Types[i] = Incremental->Edges.Types[OldEdge];
 			}
 		}
 	}
+	
+	const TBitArray<>* DirtyLines = bDiffed ? &Diff.GetDirtyLines() : nullptr;
+	MarkCorner(Edges, DirtyLines);
+	FilterOnlyInnerEdge(Edges, DirtyLines);
+	MarkEntryEdges(Edges, DirtyLines);
+	MakeCornerArray(Edges, OutResult.Corners);
+
+	if (Incremental)
+	{
+		TArray<TArray<FEntry>> CornerEntries;
+		TakeSteps(Edges, OutResult.Corners, OutResult.Entries, true, bDiffed ? Incremental : nullptr, bDiffed ? &Diff : nullptr, &CornerEntries);
+		Edges.ToView(OutResult.WallEdges);
+		
+		Incremental->Edges = MoveTemp(Edges);
+		Incremental->Corners = OutResult.Corners;
+		Incremental->CornerEntries = MoveTemp(CornerEntries);
+		Incremental->Radius = Radius;
+		Incremental->SettingsHash = SettingsHash;
+		Incremental->NavSerial = NavSerial;
+		Incremental->bValid = true;
+	}
+	else
+	{
+		TakeSteps(Edges, OutResult.Corners, OutResult.Entries, true);
+		Edges.ToView(OutResult.WallEdges);
+	}
+	
+	INC_DWORD_STAT_BY(STAT_NavAware_Corners, OutResult.Corners.Num());
+	INC_DWORD_STAT_BY(STAT_NavAware_Entries, OutResult.Entries.Num());
+	SET_DWORD_STAT(STAT_NavAware_QueryCorners, OutResult.Corners.Num());
+	SET_DWORD_STAT(STAT_NavAware_QueryEntries, OutResult.Entries.Num());
 }
 
-void ANavAwareEnhancedBase::GatherEdgesWithSorting(TArray<FNavigationWallEdge>& InArray, TArray<FNavPoint>& OutArray, bool bDebug)
+FNavAwareIncrementalState* ANavAwareEnhancedBase::GetIncrementalState()
 {
-	FScopeLock Lock(&GatherSortingEdgesSection);
+	//tiles are swapped while building, the last edge set tells nothing about the next one
+	if (!bIncrementalUpdate || MainNavSystem == nullptr || MainNavSystem->IsNavigationBuildInProgress())
+	{
+		return nullptr;
+	}
 	
-	//OutArray.Empty();
-	TArray<FNavPoint> TempArray;
+	if (!IncrementalState.IsValid())
+	{
+		IncrementalState = MakeShared<FNavAwareIncrementalState>();
+	}
+	return IncrementalState.Get();
+}
+
+uint32 ANavAwareEnhancedBase::GetNavSerial() const
+{
+	const UNavAwareCacheSubsystem* Cache = GetWorld()->GetSubsystem<UNavAwareCacheSubsystem>();
+	return Cache ? Cache->GetInvalidationSerial() : 0;
+}
+
+uint32 ANavAwareEnhancedBase::GetAreaSerial(const FVector& Origin, float Radius, int32 StartTile) const
+{
+	const UNavAwareCacheSubsystem* Cache = GetWorld()->GetSubsystem<UNavAwareCacheSubsystem>();
+	return Cache ? Cache->GetAreaSerial(MainRecastNavMesh, Origin, Radius, StartTile) : 0;
+}
+
+#if WITH_EDITOR
+void ANavAwareEnhancedBase::BakeAwarenessData()
+{
+	MainNavSystem = FNavigationSystem::GetCurrent<UNavigationSystemV1>(GetWorld());
+	MainRecastNavMesh = MainNavSystem ? Cast<ARecastNavMesh>(MainNavSystem->GetDefaultNavDataInstance()) : nullptr;
+	if (MainRecastNavMesh == nullptr || BakeCellSize <= 0.f)
+	{
+		UE_LOG(NavAware, Error, TEXT("Nothing to bake, no navmesh in this level!"))
+		return;
+	}
+
+	SnapshotPipelineSettings();
+	FSharedConstNavQueryFilter QueryFilter = MainNavSystem->CreateDefaultQueryFilterCopy();
+	FNavAwareBakedDataWriter Writer(BakeCellSize, BakeRadius, GetPipelineSettingsHash());
+	TSet<FIntVector> BakedCells;
+	FNavAwareResult Result;
+	
+	const int32 NumTiles = MainRecastNavMesh->GetNavMeshTilesCount();
+	FScopedSlowTask SlowTask(NumTiles, NSLOCTEXT("NavAware", "BakingAwareness", "Baking awareness data..."));
+	SlowTask.MakeDialog(true);
 	
-	if(InArray.Num() == 0)
+	for (int32 TileIndex = 0; TileIndex < NumTiles; TileIndex++)
+	{
+		SlowTask.EnterProgressFrame();
+		if (SlowTask.ShouldCancel()) return;
+		
+		TArray<FNavPoly> Polys;
+		MainRecastNavMesh->GetPolysInTile(TileIndex, Polys);
+		
+		for (const auto& Poly : Polys)
+		{
+			const FIntVector Cell = FNavAwareBakedData::GetCellKey(Poly.Center, BakeCellSize);
+			if (BakedCells.Contains(Cell)) continue;
+			BakedCells.Add(Cell);
+
+			RunPipeline(Poly.Center, BakeRadius, QueryFilter, Result);
+			Writer.AddCell(Cell, Poly.Center, Result);
+		}
+	}
+
+	const FString Path = FNavAwareBakedData::GetBakedDataPath(GetWorld());
+	if (Writer.Save(Path))
+	{
+		UE_LOG(NavAware, Display, TEXT("Baked %d cells of awareness data to %s"), Writer.GetNumCells(), *Path)
+	}
+	else
+	{
+		UE_LOG(NavAware, Error, TEXT("Failed writing baked awareness data to %s"), *Path)
+	}
+}
+
+void ANavAwareEnhancedBase::RecordEdgeFixture()
+{
+	MainNavSystem = FNavigationSystem::GetCurrent<UNavigationSystemV1>(GetWorld());
+	MainRecastNavMesh = MainNavSystem ? Cast<ARecastNavMesh>(MainNavSystem->GetDefaultNavDataInstance()) : nullptr;
+	if (MainRecastNavMesh == nullptr)
 	{
+		UE_LOG(NavAware, Error, TEXT("Nothing to record, no navmesh in this level!"))
 		return;
 	}
 
-	/*
-	Transfer points from InArray into a TMap*/
-	TMap<FVector, FVector> EdgesMap;
-	for (const auto& [x, y] : InArray)
+	const FVector Origin = GetActorLocation();
+	const NavNodeRef NodeRef = MainRecastNavMesh->FindNearestPoly(Origin, FVector(500.f, 500.f, 500.f));
+	TArray<FNavigationWallEdge> GetEdges;
+	MainRecastNavMesh->FindEdges(NodeRef, Origin, BakeRadius, MainNavSystem->CreateDefaultQueryFilterCopy(), GetEdges);
+
+	const FString MapName = FPackageName::GetShortName(UWorld::RemovePIEPrefix(GetWorld()->GetOutermost()->GetName()));
+	const FString Path = FNavAwareEdgeFixture::GetFixtureDir() / FString::Printf(TEXT("%s_%s.edges"), *MapName, *GetName());
+	if (FNavAwareEdgeFixture::Save(Path, GetEdges))
+	{
+		UE_LOG(NavAware, Display, TEXT("Recorded %d edges to %s"), GetEdges.Num(), *Path)
+	}
+	else
+	{
+		UE_LOG(NavAware, Error, TEXT("Failed writing edge fixture to %s"), *Path)
+	}
+}
+#endif
+
+void ANavAwareEnhancedBase::ApplyResult(FNavAwareResult& InResult, bool bDebug)
+{
+	Swap(WallEdges, InResult.WallEdges);
+	Swap(Corners, InResult.Corners);
+	Swap(Entries, InResult.Entries);
+	LastResultTime = GetWorld()->GetTimeSeconds();
+	VisLogResult();
+
+	if (bDebug)
+	{
+		DrawDebugResult();
+	}
+	//the shapes of an earlier debug query would stay on screen over this result
+	else if (ANavAwareDebugRenderer* Renderer = DebugRenderer.Get())
 	{
-		EdgesMap.Emplace(x, y);
+		Renderer->GetRenderComponent()->ClearAgent(this);
+		DebugRenderer.Reset();
 	}
 
+	if (bReportToPerception && UAISense_NavAwareness::HasListeners())
+	{
+		ReportToPerception();
+	}
 	
-	/*algorithm to transfer points from TMap to OutArray, sorted by these orders:
-	 * edges on the same line has the same LineID
-	 * edges on the same line must connect with heads to tails(Start and End)
-	 * single edge will be sent to the top of the array, with LineID '0'
-	 */
+	OnNearestEdgesUpdated.Broadcast(this);
+}
+
+void ANavAwareEnhancedBase::ReportToPerception()
+{
+	FAINavAwarenessEvent Event;
+	Event.Instigator = this;
+	Event.Points.Reserve(Corners.Num() + Entries.Num());
 	
-	int32 CurrentLineEntry = 0;	//CurrentLineEntry: supposed to be the entry index of the current line
-	uint8 CurrentIndex = 0;		//For marking id
-	int32 CurrentLineID = -1;	//LineID: supposed to be the id of the current line
+	for (const FCorner& Corner : Corners)
+	{
+		if (!WallEdges.IsValidIndex(Corner.CornerStart) || !WallEdges.IsValidIndex(Corner.CornerEnd)) continue;
+		
+		//center of the corner's edges
+		FAINavAwarenessPoint& Point = Event.Points.AddDefaulted_GetRef();
+		Point.Location = (WallEdges[Corner.CornerStart].Start + WallEdges[Corner.CornerEnd].End) * 0.5;
+	}
+	for (const FEntry& Entry : Entries)
+	{
+		FAINavAwarenessPoint& Point = Event.Points.AddDefaulted_GetRef();
+		Point.Location = Entry.Location;
+		Point.Width = Entry.Width;
+		Point.bIsEntry = true;
+	}
 	
-	/*Initialize the first element
-	 */
-	//Check if this element is single
-	if (EdgesMap.Find(InArray[0].End) != nullptr || EdgesMap.FindKey(InArray[0].Start) != nullptr)
+	UAISense_NavAwareness::ReportNavAwarenessEvent(this, Event);
+}
+
+void ANavAwareEnhancedBase::OnAsyncQueryFinished(bool bDebug, const FVector& Origin, float Radius, uint32 AreaSerial, const FNavAwareCacheKey& CacheKey)
+{
+	//EndPlay already waited for this query and let go of it
+	if (!bAsyncQueryPending) return;
+	
+	bAsyncQueryPending = false;
+	ReleaseNavBuildLock();
+
+	//tiles the task read changed under it anyway, e.g. flushed by hand, its edges may be gone already.
+	//Changes elsewhere on the navmesh don't touch this result
+	if (GetAreaSerial(Origin, Radius, CacheKey.TileIndex) != AreaSerial)
 	{
-		CurrentIndex++;
-		CurrentLineID = 1;	
-		TempArray.Add(FNavPoint(InArray[0].Start, InArray[0].End, CurrentIndex, CurrentLineID));
+		FindNearestEdges(bDebug, Radius);
+		CompletedAsyncQuerySerial = AsyncQuerySerial;
+		return;
 	}
-	else
+	
+	CompletedAsyncQuerySerial = AsyncQuerySerial;
+	StoreCachedResult(CacheKey, Origin, Radius, BackBuffer);
+	ApplyResult(BackBuffer, bDebug);
+}
+
+void ANavAwareEnhancedBase::SnapshotPipelineSettings()
+{
+	check(IsInGameThread() && !bAsyncQueryPending);
+	
+	QuerySettings.NavMesh = MainRecastNavMesh;
+	QuerySettings.MaxDistForFakeCorner = maxDistForFakeCorner;
+	QuerySettings.MinCurDeg = minCurDeg;
+	QuerySettings.MinCompens = minCompens;
+	QuerySettings.CornerBlur = CornerBlur;
+	QuerySettings.MaxEntryWidth = MaxEntryWidth;
+	QuerySettings.EdgeWeldTolerance = EdgeWeldTolerance;
+	QuerySettings.SettingsHash = GetPipelineSettingsHash();
+}
+
+bool ANavAwareEnhancedBase::AcquireNavBuildLock()
+{
+	UNavAwareCacheSubsystem* Cache = GetWorld()->GetSubsystem<UNavAwareCacheSubsystem>();
+	if (Cache == nullptr || !Cache->AcquireNavBuildLock()) return false;
+	
+	bHoldsNavBuildLock = true;
+	return true;
+}
+
+void ANavAwareEnhancedBase::ReleaseNavBuildLock()
+{
+	if (!bHoldsNavBuildLock) return;
+	bHoldsNavBuildLock = false;
+	
+	if (UNavAwareCacheSubsystem* Cache = GetWorld()->GetSubsystem<UNavAwareCacheSubsystem>())
+	{
+		Cache->ReleaseNavBuildLock();
+	}
+}
+
+UNavAwareCacheSubsystem* ANavAwareEnhancedBase::GetAwarenessCache() const
+{
+	//results of a navmesh that is still building must not be cached
+	if (!bUseAwarenessCache || MainNavSystem == nullptr || MainNavSystem->IsNavigationBuildInProgress())
+	{
+		return nullptr;
+	}
+	return GetWorld()->GetSubsystem<UNavAwareCacheSubsystem>();
+}
+
+bool ANavAwareEnhancedBase::FindCachedResult(const FVector& Origin, float Radius, FNavAwareResult& OutResult, FNavAwareCacheKey& OutKey) const
+{
+	OutKey = FNavAwareCacheKey();
+	
+	const UNavAwareCacheSubsystem* BakedCache = GetWorld()->GetSubsystem<UNavAwareCacheSubsystem>();
+	if (bUseBakedData && BakedCache && BakedCache->FindBakedResult(Origin, Radius, GetPipelineSettingsHash(), OutResult))
 	{
-		CurrentLineID = 0;
-		TempArray.Add(FNavPoint(InArray[0].Start, InArray[0].End, CurrentIndex, CurrentLineID));
+		return true;
 	}
-	EdgesMap.Remove(InArray[0].Start);
 	
-	FNavPoint LineHeader = TempArray[0];	//LineHeader: supposed to be the head of the current line
-	FNavPoint Connector = LineHeader;	//Connector: supposed to be the tail of the current line
+	UNavAwareCacheSubsystem* Cache = GetAwarenessCache();
+	return Cache && Cache->MakeKey(MainRecastNavMesh, Origin, Radius, GetPipelineSettingsHash(), OutKey)
+		&& Cache->FindResult(OutKey, OutResult);
+}
+
+void ANavAwareEnhancedBase::StoreCachedResult(const FNavAwareCacheKey& Key, const FVector& Origin, float Radius, const FNavAwareResult& Result) const
+{
+	UNavAwareCacheSubsystem* Cache = GetAwarenessCache();
+	if (Cache && Key.IsValid())
+	{
+		Cache->StoreResult(Key, Result, MainRecastNavMesh, Origin, Radius);
+	}
+}
+
+uint32 ANavAwareEnhancedBase::GetPipelineSettingsHash() const
+{
+	uint32 Hash = GetTypeHash(maxDistForFakeCorner);
+	Hash = HashCombine(Hash, GetTypeHash(minCurDeg));
+	Hash = HashCombine(Hash, GetTypeHash(minCompens));
+	Hash = HashCombine(Hash, GetTypeHash(CornerBlur));
+	Hash = HashCombine(Hash, GetTypeHash(EdgeWeldTolerance));
+	Hash = HashCombine(Hash, GetTypeHash(MaxEntryWidth));
+	return Hash;
+}
+
+void ANavAwareEnhancedBase::DumpLastQueryTrace() const
+{
+#if NAVAWARE_WITH_TRACE
+	FScopeLock TraceLock(&LastQueryTraceSection);
+	LastQueryTrace.Dump(GetName());
+#endif
+}
+
+void ANavAwareEnhancedBase::DrawDebugResult()
+{
+	if (bShowLog)
+	{
+		DumpLastQueryTrace();
+	}
+
+#if NAVAWARE_WITH_DEBUG_DRAW
+	if (!DebugRenderer.IsValid())
+	{
+		DebugRenderer = ANavAwareDebugRenderer::Get(GetWorld());
+	}
 	
-	/*The main part of the algorithm, loop through every element until map is empty, which means the transfer is completed
+	FNavAwareDebugShapes Shapes;
+	for (const auto&  [Start, End, ID, LineID, Type, Degree, Prev, Next] : WallEdges)
+	{
+		Shapes.AddBox(End, FVector(10.f, 10.f, 20.f), FColor::Red);
+		Shapes.AddArrow(Start, End, FColor::MakeRedToGreenColorFromScalar(LineID * 0.15f), 20.f);
+		Shapes.AddText(End, FString::Printf(TEXT("[%d][%02d]Deg: %.2f, Length: %.2f"), LineID, ID, Degree, (End - Start).Length()), FColor::White);
+		
+		if (Type == EWallType::Corner)
+		{
+			Shapes.AddSphere(End, 20.f, FColor::Cyan);
+		}
+		else if (Type == EWallType::Entry)
+		{
+			Shapes.AddSphere(End, 20.f, FColor::Purple);
+		}
+		if (bShowLog)
+		{
+			//prints out all elements
+			UE_LOG(NavAware, Display,
+                    TEXT("[Start: [%04.1f, %04.1f], End: [%04.1f, %04.1f], ID: %02d, LineID: %d, Type: %d, Degree: %.2f, Prev: [%02d], Next: [%02d]]"),
+                    Start.X, Start.Y, End.X, End.Y, ID, LineID, Type, Degree, Prev, Next)
+		}
+	}
+	for (const auto& [Start, End, ID] : Corners)
+	{
+		if (bShowLog)
+		{
+			UE_LOG(NavAware, Display, TEXT("Corner[%d]: Start: %02d, End: %02d"), ID, Start, End)
+		}
+		
+		int32 DrawingEdge = Start;
+		while (WallEdges.IsValidIndex(DrawingEdge))
+		{
+			Shapes.AddArrow(WallEdges[DrawingEdge].Start, WallEdges[DrawingEdge].End, FColor::Purple, 10.f, 5.f);
+			if (DrawingEdge == End) break;
+			DrawingEdge = WallEdges[DrawingEdge].NextEdge;
+		}
+		
+		Shapes.AddBox(WallEdges[Start].Start, FVector(5.f, 5.f, 50.f), FColor::Green);
+		Shapes.AddBox(WallEdges[End].End, FVector(5.f, 5.f, 50.f), FColor::Green);
+	}
+	for (const auto& Entry : Entries)
+	{
+		const FNavPoint& EdgeA = WallEdges[Entry.EdgeA];
+		Shapes.AddArrow(Entry.Start, Entry.End, FColor::Green, 5.f);
+		Shapes.AddArrow(Entry.Start, GetPerpendicularLineFromPointOnEdgeInPolySide(Entry.Start, EdgeA.Start, EdgeA.End), FColor::Yellow, 5.f);
+		
+		if (bShowLog)
+		{
+			UE_LOG(NavAware, Display, TEXT("Entry: CornerEdge: [%02d], TargetEdge: [%02d], width: %.1f, LineA: %d, LineB: %d"), Entry.EdgeA, Entry.EdgeB, Entry.Width, Entry.CurrentLineID, Entry.TargetLineID)
+		}
+	}
+
+	if (ANavAwareDebugRenderer* Renderer = DebugRenderer.Get())
+	{
+		Renderer->GetRenderComponent()->SetAgentShapes(this, MoveTemp(Shapes));
+	}
+#endif
+}
+
+void ANavAwareEnhancedBase::VisLogResult() const
+{
+#if ENABLE_VISUAL_LOG
+	if (!FVisualLogger::IsRecording()) return;
+
+	//wall chains, one color per line
+	for (const FNavPoint& Edge : WallEdges)
+	{
+		UE_VLOG_ARROW(this, NavAware, Verbose, Edge.Start, Edge.End, FColor::MakeRedToGreenColorFromScalar(Edge.LineID * 0.15f), TEXT(""));
+	}
+	
+	for (const FCorner& Corner : Corners)
+	{
+		int32 DrawingEdge = Corner.CornerStart;
+		while (WallEdges.IsValidIndex(DrawingEdge))
+		{
+			UE_VLOG_SEGMENT_THICK(this, NavAware, Log, WallEdges[DrawingEdge].Start, WallEdges[DrawingEdge].End, FColor::Purple, 5, TEXT(""));
+			if (DrawingEdge == Corner.CornerEnd) break;
+			DrawingEdge = WallEdges[DrawingEdge].NextEdge;
+		}
+		
+		if (WallEdges.IsValidIndex(Corner.CornerStart))
+		{
+			UE_VLOG_LOCATION(this, NavAware, Log, WallEdges[Corner.CornerStart].Start, 20.f, FColor::Cyan, TEXT("Corner %d"), Corner.CornerID);
+		}
+	}
+	
+	for (const FEntry& Entry : Entries)
+	{
+		UE_VLOG_ARROW(this, NavAware, Log, Entry.Start, Entry.End, FColor::Green, TEXT("Entry %d-%d, width %.1f"), Entry.CurrentLineID, Entry.TargetLineID, Entry.Width);
+	}
+	
+	UE_VLOG(this, NavAware, Log, TEXT("Edges: %d, Corners: %d, Entries: %d"), WallEdges.Num(), Corners.Num(), Entries.Num());
+#endif
+}
+
+void ANavAwareEnhancedBase::GatherEdgesWithSorting(TArray<FNavigationWallEdge>& InArray, const FVector& Origin, FNavAwareEdgeStore& OutEdges, bool bDebug)
+{
+	NAVAWARE_SCOPE(GatherEdgesWithSorting);
+	FScopeLock Lock(&GatherSortingEdgesSection);
+	
+	OutEdges.Reset(Origin);
+	
+	const int32 Num = InArray.Num();
+	if (Num == 0)
+	{
+		return;
+	}
+
+	/*
+	 * Bucket every edge's Start into a quantized grid, edges sharing a cell are chained through StartCellNext.
+	 * Cells are as large as the weld tolerance, so a welded endpoint is always in the same or a neighbor cell
 	 */
-	while(EdgesMap.Num() != 0)
+	const float WeldTolerance = FMath::Max(QuerySettings.EdgeWeldTolerance, UE_KINDA_SMALL_NUMBER);
+	const float WeldToleranceSquared = WeldTolerance * WeldTolerance;
+	const auto ToCell = [WeldTolerance](const FVector& Point)
+	{
+		return FIntVector(
+			FMath::FloorToInt(Point.X / WeldTolerance),
+			FMath::FloorToInt(Point.Y / WeldTolerance),
+			FMath::FloorToInt(Point.Z / WeldTolerance));
+	};
+	
+	TMap<FIntVector, int32> StartCells;
+	StartCells.Reserve(Num);
+	TArray<int32> StartCellNext;
+	StartCellNext.Init(INDEX_NONE, Num);
+	for (int32 i = 0; i < Num; i++)
 	{
-		CurrentIndex++;
-		/*
-		 *Try to find edges that connected to current line*/
-		//Edge found that connected by connector if there is one(tail)
-		if (const FVector* Value = EdgesMap.Find(Connector.End))
+		const FIntVector Cell = ToCell(InArray[i].Start);
+		if (int32* CellHead = StartCells.Find(Cell))
 		{
-			TempArray.Push(FNavPoint(Connector.End, *Value, CurrentIndex, CurrentLineID));
-			EdgesMap.Remove(Connector.End);
-			Connector = TempArray.Last();
-			
-			continue;
+			StartCellNext[i] = *CellHead;
+			*CellHead = i;
 		}
-		//Edge found that connected by header if there is one(head)
-		if (const FVector* Key = EdgesMap.FindKey(LineHeader.Start))
+		else
 		{
-			TempArray.Insert(FNavPoint(*Key, LineHeader.Start, CurrentIndex, CurrentLineID), CurrentLineEntry);
-			EdgesMap.Remove(*Key);
-			LineHeader = TempArray[CurrentLineEntry];
-			
-			continue;
+			StartCells.Add(Cell, i);
 		}
+	}
 
-		/*
-		 *No connected edge found, starts a new line*/
-		const auto it = EdgesMap.CreateIterator();
-		//1)if its single 2)if it has head 2)if it has tail 
-			//if it has tail, add this first
-		if (const FVector* TailValue = EdgesMap.Find(it.Value()))
+	//Find an edge whose Start welds to given point, own cell first since exact matches are the common case
+	const auto FindEdgeStartingAt = [&](const FVector& Point, int32 Exclude)
+	{
+		const FIntVector Cell = ToCell(Point);
+		for (int32 Offset = 0; Offset < 27; Offset++)
 		{
-			CurrentLineID += 1;
-			TempArray.Push(FNavPoint(it.Key(), it.Value(), CurrentIndex, CurrentLineID));
-			LineHeader = TempArray.Last();
-			
-			CurrentIndex++;
-			TempArray.Push(FNavPoint(it.Value(), *TailValue, CurrentIndex, CurrentLineID));
-			Connector = TempArray.Last();
-			CurrentLineEntry = TempArray.Num() - 2;
-			EdgesMap.Remove(it.Value());
-		}
-			//if it has head, add its head first
-		else if (const FVector* HeadKey = EdgesMap.FindKey(it.Key()))
-		{
-			CurrentLineID += 1;
-			TempArray.Push(FNavPoint(*HeadKey, it.Key(), CurrentIndex, CurrentLineID));
-			LineHeader = TempArray.Last();
-			EdgesMap.Remove(*HeadKey);
+			//Offset 0 maps to (0,0,0), then the other 26 neighbors
+			const int32 Code = (Offset + 13) % 27;
+			const FIntVector Neighbor = Cell + FIntVector(Code % 3 - 1, Code / 3 % 3 - 1, Code / 9 - 1);
 			
-			CurrentIndex++;
-			TempArray.Push(FNavPoint(it.Key(), it.Value(), CurrentIndex, CurrentLineID));
-			Connector = TempArray.Last();
-			CurrentLineEntry = TempArray.Num() - 2;
+			const int32* CellHead = StartCells.Find(Neighbor);
+			for (int32 Index = CellHead ? *CellHead : INDEX_NONE; Index != INDEX_NONE; Index = StartCellNext[Index])
+			{
+				if (Index != Exclude && FVector::DistSquared(Point, InArray[Index].Start) <= WeldToleranceSquared)
+				{
+					return Index;
+				}
+			}
 		}
-			//if it is single, insert it to the top
-		else
+		return static_cast<int32>(INDEX_NONE);
+	};
+
+	/*
+	 * Link tails to heads, an edge can only be taken as next by one edge
+	 */
+	TArray<int32> Next;
+	TArray<int32> Prev;
+	Next.Init(INDEX_NONE, Num);
+	Prev.Init(INDEX_NONE, Num);
+	for (int32 i = 0; i < Num; i++)
+	{
+		const int32 Found = FindEdgeStartingAt(InArray[i].End, i);
+		if (Found != INDEX_NONE && Prev[Found] == INDEX_NONE)
 		{
-			TempArray.Insert(FNavPoint(it.Key(), it.Value(), CurrentIndex, 0), 0);
-			CurrentLineEntry += 1;
+			Next[i] = Found;
+			Prev[Found] = i;
 		}
-		EdgesMap.Remove(it.Key());
 	}
 
-	OutArray = TempArray;
+	/*Transfer edges to OutEdges, sorted by these orders:
+	 * single edges are sent to the top of the store, with LineID '0'
+	 * edges on the same line has the same LineID
+	 * edges on the same line connect heads to tails(Start and End), welded endpoints are snapped together
+	 */
+	OutEdges.Reserve(Num);
+	for (int32 i = 0; i < Num; i++)
+	{
+		if (Prev[i] == INDEX_NONE && Next[i] == INDEX_NONE)
+		{
+			OutEdges.Add(OutEdges.ToLocal(InArray[i].Start), OutEdges.ToLocal(InArray[i].End), 0);
+		}
+	}
+
+	TArray<bool> Visited;
+	Visited.Init(false, Num);
+	int32 CurrentLineID = 0;
+	
+	const auto EmitLine = [&](int32 Head)
+	{
+		CurrentLineID++;
+		const int32 LineEntry = OutEdges.Num();
+		
+		for (int32 Index = Head; Index != INDEX_NONE && !Visited[Index]; Index = Next[Index])
+		{
+			Visited[Index] = true;
+			const FVector3f Start = OutEdges.Num() > LineEntry ? OutEdges.Ends.Last() : OutEdges.ToLocal(InArray[Index].Start);
+			OutEdges.Add(Start, OutEdges.ToLocal(InArray[Index].End), CurrentLineID);
+		}
+
+		//closed loop, snap the head onto the tail
+		if (Prev[Head] != INDEX_NONE)
+		{
+			OutEdges.Starts[LineEntry] = OutEdges.Ends.Last();
+		}
+	};
+
+	//Open lines first start from their heads
+	for (int32 i = 0; i < Num; i++)
+	{
+		if (Prev[i] == INDEX_NONE && Next[i] != INDEX_NONE)
+		{
+			EmitLine(i);
+		}
+	}
+	//Whatever is left are loops, any edge is good as head
+	for (int32 i = 0; i < Num; i++)
+	{
+		if (!Visited[i] && Prev[i] != INDEX_NONE)
+		{
+			EmitLine(i);
+		}
+	}
 	
-	UE_LOG(NavAware, Warning, TEXT("Finished sorting, InArray count: %d, OutArray count: %d"), InArray.Num(), OutArray.Num())
+	NAVAWARE_TRACE(EdgesSorted, InArray.Num(), OutEdges.Num());
 }
 
-void ANavAwareEnhancedBase::EdgeLinker(TArray<FNavPoint>& InOutArray)
+void ANavAwareEnhancedBase::EdgeLinker(FNavAwareEdgeStore& InOutEdges)
 {
-	if (InOutArray.Num() == 0) return;
+	NAVAWARE_SCOPE(EdgeLinker);
+	
+	const int32 Num = InOutEdges.Num();
+	if (Num == 0) return;
 
-	uint8 LineHeader = 0;
-	const uint8 Num = InOutArray.Num();
-	for (uint8 i = 0; i < Num - 1; i++)
-	{
-		if (InOutArray[i].LineID == 0) {LineHeader++; continue;}
+	const TArray<int32>& LineIDs = InOutEdges.LineIDs;
+	TArray<int32>& PrevEdges = InOutEdges.PrevEdges;
+	TArray<int32>& NextEdges = InOutEdges.NextEdges;
 
-		FNavPoint& CurEdge = InOutArray[i];
-		FNavPoint& NxtEdge = InOutArray[i+1];
+	int32 LineHeader = 0;
+	for (int32 i = 0; i < Num - 1; i++)
+	{
+		if (LineIDs[i] == 0) {LineHeader++; continue;}
 		
-		if (CurEdge.LineID == NxtEdge.LineID)
+		if (LineIDs[i] == LineIDs[i + 1])
 		{
-			CurEdge.NextEdge = &NxtEdge;
-			NxtEdge.PrevEdge = &CurEdge;
+			NextEdges[i] = i + 1;
+			PrevEdges[i + 1] = i;
 		}
 		else//end of the current line
 		{
-			FNavPoint& HeadEdge = InOutArray[LineHeader];
-			if (CurEdge.End == HeadEdge.Start)	//check if line is circle
+			if (InOutEdges.Ends[i] == InOutEdges.Starts[LineHeader])	//check if line is circle
 			{
-				CurEdge.NextEdge = &HeadEdge;
-				HeadEdge.PrevEdge = &CurEdge;
+				NextEdges[i] = LineHeader;
+				PrevEdges[LineHeader] = i;
 			}
 			LineHeader = i + 1;
 		}
 	}
 	//End of the array
-	FNavPoint& CurEdge = InOutArray.Last();
-	FNavPoint& HeadEdge = InOutArray[LineHeader];
-	if (CurEdge.End == HeadEdge.Start)	//check if line is circle
+	const int32 Last = Num - 1;
+	if (InOutEdges.Ends[Last] == InOutEdges.Starts[LineHeader])	//check if line is circle
 	{
-		CurEdge.NextEdge = &HeadEdge;
-		HeadEdge.PrevEdge = &CurEdge;
+		NextEdges[Last] = LineHeader;
+		PrevEdges[LineHeader] = Last;
 	}
 }
 
-void ANavAwareEnhancedBase::MarkCorner(TArray<FNavPoint>& InOutArray)
+void ANavAwareEnhancedBase::MarkCorner(FNavAwareEdgeStore& InOutEdges, const TBitArray<>* DirtyLines)
 {
+	NAVAWARE_SCOPE(MarkCorner);
 	
 	FScopeLock Lock(&MarkingCornerSection);
 	
-	if (InOutArray.Num() == 0) return;
+	const int32 Num = InOutEdges.Num();
+	if (Num == 0) return;
+
+	//thresholds turned into cosines once, so edges are compared without trig
+	const float CosMinCurDeg = FMath::Cos(FMath::DegreesToRadians(QuerySettings.MinCurDeg));
+	const float CosMinCompens = FMath::Cos(FMath::DegreesToRadians(QuerySettings.MinCompens));
+
+	/*
+	 * One flat pass over the chain: turn of every edge to its next edge, 4 edges per lane batch
+	 */
+	FDirectionSoA Directions;
+	FDirectionSoA NextDirections;
+	Directions.SetNumUninitialized(Num);
+	NextDirections.SetNumUninitialized(Num);
+	for (int32 i = 0; i < Num; i++)
+	{
+		const FVector3f Direction = InOutEdges.GetDirection(i);
+		const int32 NextEdge = InOutEdges.NextEdges[i];
+		Directions.Set(i, Direction);
+		//an edge without next turns to itself, which is no turn; its turn is never read anyway
+		NextDirections.Set(i, NextEdge != INDEX_NONE ? InOutEdges.GetDirection(NextEdge) : Direction);
+	}
+	TArray<FXYTurn> Turns;
+	XYTurnBatch(Directions, NextDirections, Turns);
 	
 	/*
 	 * Filtering wall type
 	 */
 	//Define the start index, to skip LineID '0'
-	uint8 StartIndex = 0;
-	for (auto& currentElem : InOutArray)
+	int32 StartIndex = 0;
+	while (StartIndex < Num && InOutEdges.LineIDs[StartIndex] == 0)
 	{
-		if (currentElem.LineID != 0) break;
 		StartIndex++;
 	}
 	
-	float curDeg = 0.f;
-	float lastDeg = 0.f;
-	uint8 Num = InOutArray.Num();
-	for (uint8 i = StartIndex; i < Num; i++)	//loop through every element
+	FXYTurn LastTurn;
+	for (int32 i = StartIndex; i < Num; i++)	//loop through every element
 	{
-		FNavPoint& CurEdge = InOutArray[i];
-		FNavPoint* NextEdge = nullptr;
-		FNavPoint* PrevEdge = nullptr;
-		if (CurEdge.NextEdge) NextEdge = CurEdge.NextEdge;
-		if (CurEdge.PrevEdge) PrevEdge = CurEdge.PrevEdge;
-
-		//reset lastDeg when entering a new line
-		if (i > 0 && CurEdge.LineID != InOutArray[i - 1].LineID)
+		//reset last turn when entering a new line
+		if (i > 0 && InOutEdges.LineIDs[i] != InOutEdges.LineIDs[i - 1])
 		{
-			lastDeg = 0.f;
+			LastTurn = FXYTurn();
 		}
 		
-		if (NextEdge != nullptr)	//when not reach to the end of the line/array
+		//clean lines already carry their types over from the last query
+		if (DirtyLines && !(*DirtyLines)[InOutEdges.LineIDs[i]]) continue;
+		
+		if (InOutEdges.HasNext(i))	//when not reach to the end of the line/array
 		{
-			DetectCorner(InOutArray, CurEdge, *NextEdge, *PrevEdge, curDeg, lastDeg, i);
+			DetectCorner(InOutEdges, i, Turns[i], LastTurn, CosMinCurDeg, CosMinCompens);
+			//do every edge when in the same line:
+			LastTurn = Turns[i];
 		}
 	}
-	UE_LOG(NavAware, Warning, TEXT("Finished corner marking!"))
+	NAVAWARE_TRACE(CornersMarked, InOutEdges.Num(), DirtyLines ? DirtyLines->CountSetBits() : INDEX_NONE);
 }
 
-void ANavAwareEnhancedBase::DetectCorner(TArray<FNavPoint>& InOutArray, FNavPoint& CurEdge, FNavPoint& NextEdge, FNavPoint& LastEdge, float& curDeg, float& lastDeg, uint8 i) const
+void ANavAwareEnhancedBase::DetectCorner(FNavAwareEdgeStore& InOutEdges, int32 CurEdge, const FXYTurn& CurTurn, const FXYTurn& LastTurn, float CosMinCurDeg, float CosMinCompens) const
 {
-	FVector CurVect = CurEdge.End - CurEdge.Start;
-	FVector NxtVect = NextEdge.End - NextEdge.Start;
-	curDeg = XYDegrees(CurVect, NxtVect);
-	
-	CurEdge.Degree = curDeg;
+	if (!CheckCorner(CurTurn, CosMinCurDeg)) return;
 	
-	if (CheckCorner(curDeg))
+	//LastEdge is only touched when LastTurn is set, which MarkCorner only does for an edge of the same line
+	const int32 LastEdge = InOutEdges.PrevEdges[CurEdge];
+	const bool bShortEnough = InOutEdges.GetDirection(CurEdge).SizeSquared() <= FMath::Square(QuerySettings.MaxDistForFakeCorner);
+	if (bShortEnough && CheckFakeCorner(CurTurn, LastTurn, CosMinCompens) && LastEdge != INDEX_NONE && InOutEdges.Types[LastEdge] != EWallType::FakeCorner)
+	{
+		InOutEdges.Types[CurEdge] = EWallType::FakeCorner;
+		InOutEdges.Types[LastEdge] = EWallType::FakeCorner;
+	}
+	else
 	{
-		//We don't check if LastEdge is nullptr directly,
-		//We checked it in CheckFakeCorner():
-		//When LastDeg is equal to 0, we skip calling LastEdge
-		//LastDeg is handled back in MarkCorner
-		if (CurVect.Length() <= maxDistForFakeCorner && CheckFakeCorner(curDeg, lastDeg) && LastEdge.Type != EWallType::FakeCorner)
+		InOutEdges.Types[CurEdge] = EWallType::Corner;
+	}
+}
+
+void ANavAwareEnhancedBase::FillEdgeDegrees(TArray<FNavPoint>& InOutArray)
+{
+	for (auto& CurEdge : InOutArray)
+	{
+		if (InOutArray.IsValidIndex(CurEdge.NextEdge))
 		{
-			CurEdge.Type = EWallType::FakeCorner;
-			LastEdge.Type = EWallType::FakeCorner;
+			const FNavPoint& NextEdge = InOutArray[CurEdge.NextEdge];
+			CurEdge.Degree = XYDegrees(CurEdge.End - CurEdge.Start, NextEdge.End - NextEdge.Start);
 		}
 		else
 		{
-			CurEdge.Type = EWallType::Corner;
+			CurEdge.Degree = 0.f;
 		}
 	}
-	//do every edge when in the same line:
-	lastDeg = curDeg;
 }
 
-void ANavAwareEnhancedBase::FilterOnlyInnerEdge(TArray<FNavPoint>& InOutArray)
+void ANavAwareEnhancedBase::FilterOnlyInnerEdge(FNavAwareEdgeStore& InOutEdges, const TBitArray<>* DirtyLines)
 {
+	NAVAWARE_SCOPE(FilterOnlyInnerEdge);
+	
 	FScopeLock Lock(&FilterSection);
 	
-	if (InOutArray.Num() == 0) return;
+	const int32 Num = InOutEdges.Num();
+	if (Num == 0) return;
 
-	for (auto& CurEdge : InOutArray)
+	for (int32 i = 0; i < Num; i++)
 	{
-		if (CurEdge.Type != EWallType::Corner) continue;
-		FVector PolyCenter = GetEdgePolyCenter(CurEdge);
+		if (InOutEdges.Types[i] != EWallType::Corner || !InOutEdges.HasNext(i)) continue;
+		if (DirtyLines && !(*DirtyLines)[InOutEdges.LineIDs[i]]) continue;
 		
-		FVector CurVect = CurEdge.End - CurEdge.Start;
-		FVector StartToCenter = PolyCenter - CurEdge.Start;
-		const float DegToPolyCenter = XYDegrees(CurVect, StartToCenter);
+		const FVector EdgeStart = InOutEdges.GetStart(i);
+		const FVector EdgeEnd = InOutEdges.GetEnd(i);
+		FVector PolyCenter = GetEdgePolyCenter(EdgeStart, EdgeEnd);
+		
+		FVector CurVect = EdgeEnd - EdgeStart;
+		FVector NxtVect(InOutEdges.GetDirection(InOutEdges.NextEdges[i]));
+		FVector StartToCenter = PolyCenter - EdgeStart;
 
-		if (CurEdge.Degree * DegToPolyCenter >= 0.f)
+		//only signs matter: corner turning towards its own poly is an outer edge
+		if (XYTurnSign(CurVect, NxtVect) * XYTurnSign(CurVect, StartToCenter) >= 0.f)
 		{
-			CurEdge.Type = EWallType::Wall;
+			InOutEdges.Types[i] = EWallType::Wall;
 		}
 	}
 }
 
-void ANavAwareEnhancedBase::MarkEntryEdges(TArray<FNavPoint>& InOutArray)
+ECornerCheck ANavAwareEnhancedBase::CheckNeighborCorner(const FNavAwareEdgeStore& Edges, int32 Edge)
+{
+	const int32 PrevEdge = Edges.PrevEdges[Edge];
+	const int32 NextEdge = Edges.NextEdges[Edge];
+	const bool prevIsCorner = PrevEdge != INDEX_NONE && Edges.Types[PrevEdge] == EWallType::Corner;
+	const bool nextIsCorner = NextEdge != INDEX_NONE && Edges.Types[NextEdge] == EWallType::Corner;
+	
+	if (prevIsCorner && nextIsCorner)
+	{
+		return ECornerCheck::BothAreCorner;
+	}
+	if (!prevIsCorner && !nextIsCorner)
+	{
+		return ECornerCheck::None;
+	}
+	if (prevIsCorner)
+	{
+		return ECornerCheck::PrevIsCorner;
+	}
+	if (nextIsCorner)
+	{
+		return ECornerCheck::NextIsCorner;
+	}
+	
+	return ECornerCheck::None;
+}
+
+float ANavAwareEnhancedBase::GetEdgeNeighborDist(const FNavAwareEdgeStore& Edges, int32 Edge)
+{
+	float OutDistance = 0.f;
+	
+	const FVector3f CurEdgeMiddlePoint = Edges.GetMiddle(Edge);
+	
+	if (Edges.HasNext(Edge))
+	{
+		OutDistance += (CurEdgeMiddlePoint - Edges.GetMiddle(Edges.NextEdges[Edge])).Length();
+	}
+	
+	if (Edges.HasPrev(Edge))
+	{
+		OutDistance += (CurEdgeMiddlePoint - Edges.GetMiddle(Edges.PrevEdges[Edge])).Length();
+	}
+	
+	return OutDistance;
+}
+
+void ANavAwareEnhancedBase::MarkEntryEdges(FNavAwareEdgeStore& InOutEdges, const TBitArray<>* DirtyLines)
 {
 #define BOTH ECornerCheck::BothAreCorner
 #define ONLYNEXT ECornerCheck::NextIsCorner
 #define ONLYPREV ECornerCheck::PrevIsCorner
 #define NONE ECornerCheck::None
+
+	NAVAWARE_SCOPE(MarkEntryEdges);
 	
 	FScopeLock Lock(&MarkingEntrySection);
 
 	//if num is 0 or 1, theres no need to mark
-	uint8 Num = InOutArray.Num();
+	const int32 Num = InOutEdges.Num();
 	if (Num < 2) return;
 	
-	for (int i = 0; i < Num; i++)
+	for (int32 i = 0; i < Num; i++)
 	{
-		FNavPoint& CurEdge = InOutArray[i];
+		if (InOutEdges.LineIDs[i] == 0) continue;
+		if (DirtyLines && !(*DirtyLines)[InOutEdges.LineIDs[i]]) continue;
 		
-		if (CurEdge.LineID == 0) continue;
-		
-		if (CurEdge.Type < EWallType::Corner)
+		EWallType& Type = InOutEdges.Types[i];
+		if (Type < EWallType::Corner)
 		{
-			switch (CheckNeighborCorner(CurEdge))
+			switch (CheckNeighborCorner(InOutEdges, i))
 			{
 			case ONLYNEXT:
 			case ONLYPREV:
-				CurEdge.Type = EWallType::Entry;
+				Type = EWallType::Entry;
 				break;
 				
 			case BOTH:
-				if (GetEdgeNeighborDist(CurEdge) <= CornerBlur)
+				if (GetEdgeNeighborDist(InOutEdges, i) <= QuerySettings.CornerBlur)
 				{
-					CurEdge.Type = EWallType::Corner;
+					Type = EWallType::Corner;
 				}
 				else
 				{
-					CurEdge.Type = EWallType::Entry;
+					Type = EWallType::Entry;
 				}
 				break;
 				
@@ -409,55 +1099,65 @@ void ANavAwareEnhancedBase::MarkEntryEdges(TArray<FNavPoint>& InOutArray)
 		}
 	}
 
-	UE_LOG(NavAware, Warning, TEXT("Finished marking entries of the corner!"))
+	NAVAWARE_TRACE(EntryEdgesMarked, InOutEdges.Num());
 }
 
-void ANavAwareEnhancedBase::MakeCornerArray(TArray<FNavPoint>& InArray, TArray<FCorner>& OutCorners)
+void ANavAwareEnhancedBase::MakeCornerArray(const FNavAwareEdgeStore& InEdges, TArray<FCorner>& OutCorners)
 {
+	NAVAWARE_SCOPE(MakeCornerArray);
+	
 	FScopeLock Lock(&MakeCornerArraySection);
 	
-	uint8 Num = InArray.Num();
+	const int32 Num = InEdges.Num();
 	if (Num == 0) return;
 
 	OutCorners.Empty();
+
+	const TArray<EWallType>& Types = InEdges.Types;
+	const TArray<int32>& PrevEdges = InEdges.PrevEdges;
+	const TArray<int32>& NextEdges = InEdges.NextEdges;
+	const auto EdgeLength = [&InEdges](int32 Edge)
+	{
+		return InEdges.GetDirection(Edge).Length();
+	};
 	
-	for (uint8 i = 0; i < Num; i++)
+	for (int32 i = 0; i < Num; i++)
 	{
-		FNavPoint& CurEdge = InArray[i];
-		//UE_LOG(NavAware, Warning, TEXT("Checking [%02d] if is a corner start"), CurEdge.EdgeID)
+		const int32 CurEdge = i;
+		//UE_LOG(NavAware, Warning, TEXT("Checking [%02d] if is a corner start"), CurEdge)
 
 		/*Additional step, check current line if is a loop that only contains corners
 		 * if so, use the length of each edge to determine corners from the line
 		 * usually this only happen when a wall is small and straight enough to be wrapped around by edges
 		 */
-		bool isLineStart = i == 0 || i != 0 && CurEdge.LineID != InArray[i - 1].LineID;
-		bool hasPrevEdge = CurEdge.PrevEdge != nullptr;
+		bool isLineStart = i == 0 || i != 0 && InEdges.LineIDs[i] != InEdges.LineIDs[i - 1];
+		bool hasPrevEdge = InEdges.HasPrev(CurEdge);
 		if (isLineStart && hasPrevEdge)
 		{
-			//UE_LOG(NavAware, Warning, TEXT("[%02d] of [%d]this line is a loop"), CurEdge.EdgeID, CurEdge.LineID)
-			uint8 EdgeIteratedAlready = 0;;
+			//UE_LOG(NavAware, Warning, TEXT("[%02d] of [%d]this line is a loop"), CurEdge, InEdges.LineIDs[CurEdge])
+			int32 EdgeIteratedAlready = 0;;
 			bool hasOnlyCorner = false;
 			
-			if (CurEdge.Type == EWallType::Corner)
+			if (Types[CurEdge] == EWallType::Corner)
 			{
-				//UE_LOG(NavAware, Warning, TEXT("[%02d] of [%d]start looking for suitable corners for this line"), CurEdge.EdgeID, CurEdge.LineID)
-				FNavPoint* NextEdge = CurEdge.NextEdge;
+				//UE_LOG(NavAware, Warning, TEXT("[%02d] of [%d]start looking for suitable corners for this line"), CurEdge, InEdges.LineIDs[CurEdge])
+				int32 NextEdge = NextEdges[CurEdge];
 				while (true)
 				{
-					if (NextEdge == &CurEdge)
+					if (NextEdge == CurEdge)
 					{	
-						//UE_LOG(NavAware, Warning, TEXT("this line [%d] is a loop that only contains Corner!"), NextEdge->LineID)
+						//UE_LOG(NavAware, Warning, TEXT("this line [%d] is a loop that only contains Corner!"), InEdges.LineIDs[NextEdge])
 						hasOnlyCorner = true;
 						break;
 					}
 					
-					//UE_LOG(NavAware, Warning, TEXT("checking if [%02d] of [%d] is corner"), NextEdge->EdgeID, NextEdge->LineID)
-					if (NextEdge->Type != EWallType::Corner)
+					//UE_LOG(NavAware, Warning, TEXT("checking if [%02d] of [%d] is corner"), NextEdge, InEdges.LineIDs[NextEdge])
+					if (Types[NextEdge] != EWallType::Corner)
 					{
-						//UE_LOG(NavAware, Warning, TEXT("[%02d] of [%d] is not a corner! this line doesnt need to do samll wall test"), NextEdge->EdgeID, NextEdge->LineID)
+						//UE_LOG(NavAware, Warning, TEXT("[%02d] of [%d] is not a corner! this line doesnt need to do samll wall test"), NextEdge, InEdges.LineIDs[NextEdge])
 						break;
 					}
-					NextEdge = NextEdge->NextEdge;
+					NextEdge = NextEdges[NextEdge];
 					EdgeIteratedAlready++;
 				}
 			}
@@ -466,31 +1166,30 @@ void ANavAwareEnhancedBase::MakeCornerArray(TArray<FNavPoint>& InArray, TArray<F
 			
 			if (hasOnlyCorner)
             {
-	            FNavPoint& ItEdge = InArray[i];
 				//往回寻，找到第一个长度小于 300.f的作为起点：
-	            uint8 timesWentBack = 0;
-	            FNavPoint* StartPoint = &ItEdge;
-				while ((StartPoint->PrevEdge->End - StartPoint->PrevEdge->Start).Length() < 300.f && timesWentBack < EdgeIteratedAlready)
+	            int32 timesWentBack = 0;
+	            int32 StartPoint = CurEdge;
+				while (EdgeLength(PrevEdges[StartPoint]) < 300.f && timesWentBack < EdgeIteratedAlready)
 				{
-					StartPoint = StartPoint->PrevEdge;
+					StartPoint = PrevEdges[StartPoint];
 					timesWentBack++;
 				}
-				//UE_LOG(NavAware, Warning, TEXT("[%d] seemed to be a good start point..."), StartPoint->EdgeID)
-				//UE_LOG(NavAware, Warning, TEXT("Starting grouping corners by distance for line: [%d]..."), CurEdge.LineID)
+				//UE_LOG(NavAware, Warning, TEXT("[%d] seemed to be a good start point..."), StartPoint)
+				//UE_LOG(NavAware, Warning, TEXT("Starting grouping corners by distance for line: [%d]..."), InEdges.LineIDs[CurEdge])
 				
-				uint8 CornerChecked = 0;
-				FNavPoint* StartEdge = nullptr;
-				FNavPoint* EndEdge = nullptr;
+				int32 CornerChecked = 0;
+				int32 StartEdge = INDEX_NONE;
+				int32 EndEdge = INDEX_NONE;
 				
-				FNavPoint* LoopEdge = StartPoint;
+				int32 LoopEdge = StartPoint;
 				
 	            while (CornerChecked < EdgeIteratedAlready + 1)
 	            {
-	            	//UE_LOG(NavAware, Warning, TEXT("looping thourgh line [%d], now on [%02d]..."), LoopEdge->EdgeID, StartPoint->LineID)
+	            	//UE_LOG(NavAware, Warning, TEXT("looping thourgh line [%d], now on [%02d]..."), InEdges.LineIDs[StartPoint], LoopEdge)
 		            CornerChecked++;
-		            if ((LoopEdge->End - LoopEdge->Start).Length() < 300.f)
+		            if (EdgeLength(LoopEdge) < 300.f)
 		            {
-			            if (StartEdge == nullptr)
+			            if (StartEdge == INDEX_NONE)
 			            {
 				            StartEdge = LoopEdge;
 			            }
@@ -498,43 +1197,43 @@ void ANavAwareEnhancedBase::MakeCornerArray(TArray<FNavPoint>& InArray, TArray<F
 		            }
 		            else
 		            {
-			            if (EndEdge != nullptr)
+			            if (EndEdge != INDEX_NONE)
 			            {
-			            	//UE_LOG(NavAware, Warning, TEXT("found a corner: start[%02d], end[%02d]..."), StartEdge->EdgeID, EndEdge->EdgeID)
-				            OutCorners.Push(FCorner(StartEdge, EndEdge, EndEdge->EdgeID));
-			            	EndEdge = nullptr;
-			            	StartEdge = nullptr;
+			            	//UE_LOG(NavAware, Warning, TEXT("found a corner: start[%02d], end[%02d]..."), StartEdge, EndEdge)
+				            OutCorners.Push(FCorner(StartEdge, EndEdge, EndEdge));
+			            	EndEdge = INDEX_NONE;
+			            	StartEdge = INDEX_NONE;
 			            }
 		            }
-	            	LoopEdge = LoopEdge->NextEdge;
+	            	LoopEdge = NextEdges[LoopEdge];
 	            }
 				
             	//skip this line, for the future loop
-				//UE_LOG(NavAware, Warning, TEXT("Finished small wall corner grouping for line: [%d]"), CurEdge.LineID)
+				//UE_LOG(NavAware, Warning, TEXT("Finished small wall corner grouping for line: [%d]"), InEdges.LineIDs[CurEdge])
             	i += EdgeIteratedAlready;
             	continue;
             }
 		}
 
 		
-		const bool CornerStart1 = CurEdge.Type == EWallType::Corner && CurEdge.PrevEdge && CurEdge.PrevEdge->Type == EWallType::Entry;
-		const bool CornerStart2 = CurEdge.Type == EWallType::Corner && CurEdge.PrevEdge == nullptr;
+		const bool CornerStart1 = Types[CurEdge] == EWallType::Corner && hasPrevEdge && Types[PrevEdges[CurEdge]] == EWallType::Entry;
+		const bool CornerStart2 = Types[CurEdge] == EWallType::Corner && !hasPrevEdge;
 		if (CornerStart1 || CornerStart2)
 		{
-			//UE_LOG(NavAware, Warning, TEXT("Found corner start: [%02d]"), CurEdge.EdgeID)
-			FNavPoint* CornerStart = &CurEdge;
-			FNavPoint* CornerEnd = nullptr;
-			FNavPoint* NextEdge = &CurEdge;
+			//UE_LOG(NavAware, Warning, TEXT("Found corner start: [%02d]"), CurEdge)
+			const int32 CornerStart = CurEdge;
+			int32 CornerEnd = INDEX_NONE;
+			int32 NextEdge = CurEdge;
 			//Situation 1: keep iterate until find the next entry, or hit the end of the line
-			while (NextEdge->NextEdge != nullptr)
+			while (NextEdges[NextEdge] != INDEX_NONE)
 			{
-				if (i < Num - 1 && InArray[i].LineID == InArray[i + 1].LineID)
+				if (i < Num - 1 && InEdges.LineIDs[i] == InEdges.LineIDs[i + 1])
 				{
 					i++;
 				}
 				
-				NextEdge = NextEdge->NextEdge;
-				if (NextEdge->Type == EWallType::Entry)
+				NextEdge = NextEdges[NextEdge];
+				if (Types[NextEdge] == EWallType::Entry)
 				{
 					CornerEnd = NextEdge;
 					break;
@@ -542,153 +1241,207 @@ void ANavAwareEnhancedBase::MakeCornerArray(TArray<FNavPoint>& InArray, TArray<F
 			}
 			
 			//Situation 2: hit the end of the line
-			// 1) when NextEdge == nullptr: CurEdge is TET line
-			// 2) when NextEdge != nullptr: CurEdge is not TET line, but TET line is not entry
-			if (CornerEnd == nullptr)
+			// 1) when NextEdge == INDEX_NONE: CurEdge is TET line
+			// 2) when NextEdge != INDEX_NONE: CurEdge is not TET line, but TET line is not entry
+			if (CornerEnd == INDEX_NONE)
 			{
-				if (NextEdge == nullptr)
+				if (NextEdge == INDEX_NONE)
 				{
-					CornerEnd = &CurEdge;
+					CornerEnd = CurEdge;
 				}
 				else
 				{
 					CornerEnd = NextEdge;
 				}
 			}
-			OutCorners.Push(FCorner(CornerStart, CornerEnd, CornerEnd->EdgeID));
+			OutCorners.Push(FCorner(CornerStart, CornerEnd, CornerEnd));
 		}
 	}
 }
 
-void ANavAwareEnhancedBase::TakeSteps(TArray<FNavPoint>& InOutArray, bool bDebug)
+void ANavAwareEnhancedBase::TakeSteps(const FNavAwareEdgeStore& InEdges, TArray<FCorner>& InCorners, TArray<FEntry>& OutEntries, bool bDebug,
+	const FNavAwareIncrementalState* Previous, const FNavAwareEdgeDiff* Diff, TArray<TArray<FEntry>>* OutCornerEntries)
 {
-	Entries.Empty();
-	if (InOutArray.Num() < 2)	return;
+	NAVAWARE_SCOPE(TakeSteps);
 	
-	UE_LOG(NavAware, Warning, TEXT("Starting to steps for each corner and find entries from them"))
-	/*For every corner*/
-	for (auto& CurCorner : Corners)
+	OutEntries.Empty();
+	if (OutCornerEntries)
 	{
-		/*CurEntries: stores entries derived from current corner to other lines*/
-		TMap<uint8, FEntry> FoundEntries;
-		/*For every edge on this corner*/
-		FNavPoint* LoopingEdge = nullptr;
-		while (LoopingEdge != CurCorner.CornerEnd)
+		OutCornerEntries->Reset();
+		OutCornerEntries->SetNum(InCorners.Num());
+	}
+	if (InEdges.Num() < 2)	return;
+	
+	NAVAWARE_TRACE(StepsStarted, InCorners.Num());
+
+	//old corners by their start edge, to find the same corner of the last query
+	TMap<int32, int32> OldCornerByStart;
+	if (Previous && Diff)
+	{
+		for (int32 i = 0; i < Previous->Corners.Num(); i++)
 		{
-			//Init current edge
-			if (LoopingEdge != nullptr)
-			{
-				LoopingEdge = LoopingEdge->NextEdge;
-			}
-			else
-			{
-				LoopingEdge = CurCorner.CornerStart;
-			}
-			
-			FVector EdgeStart = LoopingEdge->Start;
-			FVector EdgeEnd = LoopingEdge->End;
-			uint8& LineAID = LoopingEdge->LineID;
-			
-			//Get nearest edges to this edge from other lines
-			TArray<FNavPoint*> NearestEdges;
-			SortEdgesByDistanceToGivenEdge(*LoopingEdge, InOutArray, NearestEdges);
+			OldCornerByStart.Add(Previous->Corners[i].CornerStart, i);
+		}
+	}
 
-			//For every target edge
-			for (auto& CurTargetEdge : NearestEdges)
+	//built once on first need, every edge of every corner asks it for its nearest edges
+	FNavAwareEdgeGrid EdgeGrid;
+	bool bGridBuilt = false;
+	FStepScratch Scratch;
+	TArray<FEntry> CornerEntries;
+	
+	/*For every corner*/
+	for (int32 CornerIndex = 0; CornerIndex < InCorners.Num(); CornerIndex++)
+	{
+		const FCorner& CurCorner = InCorners[CornerIndex];
+		CornerEntries.Reset();
+		
+		if (Previous && Diff && ReuseCornerEntries(InEdges, CurCorner, *Previous, *Diff, OldCornerByStart, CornerEntries))
+		{
+			NAVAWARE_TRACE(CornerReused, CurCorner.CornerID);
+		}
+		else
+		{
+			if (!bGridBuilt)
 			{
-				const FVector& TargetEdgeStart = CurTargetEdge->Start;
-				const FVector& TargetEdgeEnd = CurTargetEdge->End;
-				const uint8& LineBID = CurTargetEdge->LineID;
-					
-				
-				FVector PointOnLoopingEdge;
-				FVector PointOnTargeEdge;
-				std::tie(PointOnLoopingEdge, PointOnTargeEdge) = GetShortestLineSegBetweenTwoLineSeg(EdgeStart, EdgeEnd, TargetEdgeStart, TargetEdgeEnd);
-				float NewWidth = (PointOnTargeEdge - PointOnLoopingEdge).Length();
-					
-				const float DegreeBetweenPerpendicularLineAndEntryLine = XYDegrees(GetPerpendicularLineFromPointOnEdgeInPolySide(PointOnLoopingEdge, *LoopingEdge) - PointOnLoopingEdge, PointOnTargeEdge - PointOnLoopingEdge);
-				UE_LOG(NavAware, Warning, TEXT("CurEdge: [%02d], TargetEdge: [%02d], Degree: %.1f"), LoopingEdge->EdgeID, CurTargetEdge->EdgeID, DegreeBetweenPerpendicularLineAndEntryLine)
-				if (DegreeBetweenPerpendicularLineAndEntryLine < 45.f && DegreeBetweenPerpendicularLineAndEntryLine > -45.f)
-				{
-					if (FoundEntries.Find(LineBID))
-                    {
-                    	if (NewWidth < FoundEntries[LineBID].Width)
-                    	{
-                    		continue;
-                    	}
-                    }
-					FoundEntries.FindOrAdd(CurTargetEdge->LineID) =
-						FEntry(&CurCorner.CornerID, &LineAID, &CurTargetEdge->LineID, LoopingEdge, CurTargetEdge, PointOnLoopingEdge, PointOnTargeEdge, NewWidth, (PointOnLoopingEdge + PointOnTargeEdge)/2);
-				}
+				EdgeGrid.Build(InEdges, QuerySettings.MaxEntryWidth);
+				bGridBuilt = true;
 			}
+			FindCornerEntries(InEdges, CurCorner, EdgeGrid, Scratch, CornerEntries);
 		}
+		
 		//Push result to a global array
-		for (auto& Elem : FoundEntries)
+		for (auto& Value : CornerEntries)
 		{
-			FEntry& Value = Elem.Value;
-			if (IsUnique(Entries, Value))
+			if (IsUnique(OutEntries, Value))
 			{
-				Entries.Push(Value);
+				OutEntries.Push(Value);
 			}
 		}
 		
+		if (OutCornerEntries)
+		{
+			(*OutCornerEntries)[CornerIndex] = CornerEntries;
+		}
 	}
-	UE_LOG(NavAware, Warning, TEXT("Stepping finished"))
+	NAVAWARE_TRACE(StepsFinished, OutEntries.Num());
 }
 
-void ANavAwareEnhancedBase::SortEdgesByDistanceToGivenEdge(const FNavPoint& CurEdge, TArray<FNavPoint>& EdgesCollection, TArray<FNavPoint*>& OutArray, bool bOnlyOneForEachLine)
+void ANavAwareEnhancedBase::FindCornerEntries(const FNavAwareEdgeStore& InEdges, const FCorner& CurCorner, const FNavAwareEdgeGrid& EdgeGrid, FStepScratch& Scratch, TArray<FEntry>& OutEntries)
 {
-	if (EdgesCollection.Num() == 0)
+	/*CurEntries: stores entries derived from current corner to other lines*/
+	TMap<int32, FEntry> FoundEntries;
+	/*For every edge on this corner*/
+	int32 LoopingEdge = INDEX_NONE;
+	while (LoopingEdge != CurCorner.CornerEnd)
 	{
-		return;
-	}
-
-	for (auto& Elem : EdgesCollection)
-	{
-		OutArray.Add(&Elem);
-	}
-	
-	/*
-	 *Delete elements in CurEdge's line including itself, preventing calculating their distance
-	 */
-	bool EnteredSameLine = false;
-	for (uint8 Index = 0; Index < OutArray.Num(); Index++)
-	{
-		if (OutArray[Index]->LineID == CurEdge.LineID)
+		//Init current edge
+		if (LoopingEdge != INDEX_NONE)
 		{
-			EnteredSameLine = true;
-			OutArray.RemoveAt(Index);
-			Index--;
+			LoopingEdge = InEdges.NextEdges[LoopingEdge];
 		}
 		else
 		{
-			if (EnteredSameLine) break;
+			LoopingEdge = CurCorner.CornerStart;
+		}
+		
+		const FVector EdgeStart = InEdges.GetStart(LoopingEdge);
+		const FVector EdgeEnd = InEdges.GetEnd(LoopingEdge);
+		const int32 LineAID = InEdges.LineIDs[LoopingEdge];
+		
+		//Get nearest edges to this edge from other lines
+		TArray<int32>& NearestEdges = Scratch.NearestEdges;
+		NearestEdges.Reset();
+		SortEdgesByDistanceToGivenEdge(LoopingEdge, EdgeGrid, NearestEdges);
+
+		//Closest points to every target edge in one batch
+		Scratch.TargetSegments.Reset();
+		for (const int32 TargetEdge : NearestEdges)
+		{
+			Scratch.TargetSegments.Add(InEdges.Starts[TargetEdge], InEdges.Ends[TargetEdge]);
+		}
+		//batched in float, so in the store's local space, the points are moved back to world below
+		GetShortestLineSegsToSegmentBatch(FVector(InEdges.Starts[LoopingEdge]), FVector(InEdges.Ends[LoopingEdge]), Scratch.TargetSegments, Scratch.ClosestPoints);
+
+		//For every target edge
+		for (int32 TargetIndex = 0; TargetIndex < NearestEdges.Num(); TargetIndex++)
+		{
+			const int32 CurTargetEdge = NearestEdges[TargetIndex];
+			const int32 LineBID = InEdges.LineIDs[CurTargetEdge];
+			
+			const FVector PointOnLoopingEdge = InEdges.Origin + Scratch.ClosestPoints.PointsOnA[TargetIndex];
+			const FVector PointOnTargeEdge = InEdges.Origin + Scratch.ClosestPoints.PointsOnB[TargetIndex];
+			float NewWidth = FMath::Sqrt(Scratch.ClosestPoints.DistSquared[TargetIndex]);
+				
+			const float DegreeBetweenPerpendicularLineAndEntryLine = XYDegrees(GetPerpendicularLineFromPointOnEdgeInPolySide(PointOnLoopingEdge, EdgeStart, EdgeEnd) - PointOnLoopingEdge, PointOnTargeEdge - PointOnLoopingEdge);
+			NAVAWARE_TRACE(StepTarget, LoopingEdge, CurTargetEdge, DegreeBetweenPerpendicularLineAndEntryLine);
+			if (DegreeBetweenPerpendicularLineAndEntryLine < 45.f && DegreeBetweenPerpendicularLineAndEntryLine > -45.f)
+			{
+				if (FoundEntries.Find(LineBID))
+                {
+                	if (NewWidth < FoundEntries[LineBID].Width)
+                	{
+                		continue;
+                	}
+                }
+				FoundEntries.FindOrAdd(LineBID) =
+					FEntry(CurCorner.CornerID, LineAID, LineBID, LoopingEdge, CurTargetEdge, PointOnLoopingEdge, PointOnTargeEdge, NewWidth, (PointOnLoopingEdge + PointOnTargeEdge)/2);
+			}
 		}
 	}
-	//Sorting the Array by distance
-	FVector MiddlePointOnCurEdge = (CurEdge.Start+CurEdge.End)/2;
-	OutArray.Sort([&MiddlePointOnCurEdge](const FNavPoint& EdgeA, const FNavPoint& EdgeB)
+	
+	FoundEntries.GenerateValueArray(OutEntries);
+}
+
+bool ANavAwareEnhancedBase::ReuseCornerEntries(const FNavAwareEdgeStore& InEdges, const FCorner& CurCorner, const FNavAwareIncrementalState& Previous,
+	const FNavAwareEdgeDiff& Diff, const TMap<int32, int32>& OldCornerByStart, TArray<FEntry>& OutEntries) const
+{
+	//edges of changed lines never map back, so this also rules out corners on them
+	const int32* OldCorner = OldCornerByStart.Find(Diff.GetOldEdge(CurCorner.CornerStart));
+	if (OldCorner == nullptr || Previous.Corners[*OldCorner].CornerEnd != Diff.GetOldEdge(CurCorner.CornerEnd))
 	{
-		return FVector::Dist(MiddlePointOnCurEdge, (EdgeA.Start + EdgeA.End)/2) < FVector::Dist(MiddlePointOnCurEdge, (EdgeB.Start + EdgeB.End)/2);
-	});
+		return false;
+	}
 
-	if (bOnlyOneForEachLine)
+	//same reach as the grid query in FindCornerEntries, anything changed within it may change the entries
+	int32 CheckingEdge = CurCorner.CornerStart;
+	for (int32 Guard = 0; Guard < InEdges.Num(); Guard++)
 	{
-		//UE_LOG(NavAware, Warning, TEXT("Extracting the nearest edges of each line for edge: [%02d]"), CurEdge.EdgeID)
-		TArray<uint8> ContainedLine;
-		for (uint8 i = 0; i < OutArray.Num(); i++)
+		if (Diff.IsNearChange(InEdges.GetBounds2D(CheckingEdge), QuerySettings.MaxEntryWidth)) return false;
+		if (CheckingEdge == CurCorner.CornerEnd) break;
+		CheckingEdge = InEdges.NextEdges[CheckingEdge];
+		if (CheckingEdge == INDEX_NONE) return false;
+	}
+
+	for (const FEntry& OldEntry : Previous.CornerEntries[*OldCorner])
+	{
+		FEntry& Entry = OutEntries.Add_GetRef(OldEntry);
+		Entry.EdgeA = Diff.GetNewEdge(OldEntry.EdgeA);
+		Entry.EdgeB = Diff.GetNewEdge(OldEntry.EdgeB);
+		if (Entry.EdgeA == INDEX_NONE || Entry.EdgeB == INDEX_NONE)
 		{
-			if (ContainedLine.Contains(OutArray[i]->LineID))
-			{
-				//UE_LOG(NavAware, Warning, TEXT("The nearest edge on line [%d] is already found, ditching: [%02d]"), ArrayByDist[i].LineID, ArrayByDist[i].EdgeID)
-				OutArray.RemoveAt(i);
-				i--;
-			}
-			else
-			{
-				//UE_LOG(NavAware, Warning, TEXT("[%02d] is the first edge found on line [%d], kept"), ArrayByDist[i].EdgeID, ArrayByDist[i].LineID)
-				ContainedLine.Push(OutArray[i]->LineID);
-			}
+			OutEntries.Reset();
+			return false;
+		}
+		
+		Entry.CornerID = CurCorner.CornerID;
+		Entry.CurrentLineID = InEdges.LineIDs[Entry.EdgeA];
+		Entry.TargetLineID = InEdges.LineIDs[Entry.EdgeB];
+
+		//FindCornerEntries keeps one entry per target line, lines merged or split since would break that
+		const bool bSameLines = Diff.GetOldLine(Entry.CurrentLineID) == OldEntry.CurrentLineID && Diff.GetOldLine(Entry.TargetLineID) == OldEntry.TargetLineID;
+		const bool bUniqueTarget = !OutEntries.ContainsByPredicate([&Entry](const FEntry& Other) { return &Other != &Entry && Other.TargetLineID == Entry.TargetLineID; });
+		if (!bSameLines || !bUniqueTarget)
+		{
+			OutEntries.Reset();
+			return false;
 		}
 	}
+	
+	return true;
+}
+
+void ANavAwareEnhancedBase::SortEdgesByDistanceToGivenEdge(int32 CurEdge, const FNavAwareEdgeGrid& EdgeGrid, TArray<int32>& OutArray)
+{
+	EdgeGrid.FindNearestEdgePerLine(CurEdge, QuerySettings.MaxEntryWidth, OutArray);
 }
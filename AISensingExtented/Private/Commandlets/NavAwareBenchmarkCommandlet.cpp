@@ -0,0 +1,317 @@
+﻿#include "Commandlets/NavAwareBenchmarkCommandlet.h"
+
+#include "Actor/NavAwareEnhancedBase.h"
+#include "NavAwareEdgeFixture.h"
+#include "NavAwareEdgeStore.h"
+#include "NavAwareBakedData.h"
+#include "NavAwareIncremental.h"
+#include "Subsystem/NavAwareCacheSubsystem.h"
+#include "HAL/FileManager.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+
+
+UNavAwareBenchmarkCommandlet::UNavAwareBenchmarkCommandlet()
+{
+	IsClient = false;
+	IsEditor = false;
+	IsServer = false;
+	LogToConsole = true;
+}
+
+#if WITH_EDITOR
+/*
+ * Reads the allocator's own call counters, GMalloc stays what it is.
+ * They count every thread, so a run takes the fewest calls seen over its iterations, background work only ever adds to it
+ */
+struct FNavAwareAllocationCounter
+{
+	/*The counters are optional for an allocator, false when one allocation doesn't move them*/
+	static bool IsSupported()
+	{
+		const uint32 Before = Read();
+		FMemory::Free(FMemory::Malloc(64));
+		return Read() != Before;
+	}
+	
+	static uint32 Read()
+	{
+		return FMalloc::TotalMallocCalls + FMalloc::TotalReallocCalls;
+	}
+};
+
+/*
+ * Pipeline state right before each stage, so every stage can be timed alone on the same input
+ */
+struct FNavAwareStageInputs
+{
+	FNavAwareEdgeStore Gathered;
+	FNavAwareEdgeStore Linked;
+	FNavAwareEdgeStore Marked;
+	FNavAwareEdgeStore Filtered;
+	FNavAwareEdgeStore Classified;
+	TArray<FCorner> Corners;
+};
+
+struct FNavAwareStageResult
+{
+	FString Fixture;
+	int32 NumEdges = 0;
+	FString Stage;
+	double NsPerEdge = 0.0;
+	double AllocsPerRun = 0.0;
+	
+	/*Reads poly centers off the navmesh, which the benchmark doesn't have*/
+	bool bNeedsNavMesh = false;
+};
+
+/*
+ * Runs Stage Iterations times, Setup runs before each one outside the measured time
+ */
+template <typename TSetup, typename TStage>
+static void MeasureStage(int32 Iterations, int32 NumEdges, TSetup&& Setup, TStage&& Stage, FNavAwareStageResult& OutResult)
+{
+	uint64 Cycles = 0;
+	uint32 MinAllocations = MAX_uint32;
+	for (int32 i = 0; i < Iterations; i++)
+	{
+		Setup();
+		
+		const uint32 StartAllocations = FNavAwareAllocationCounter::Read();
+		const uint64 StartCycles = FPlatformTime::Cycles64();
+		Stage();
+		Cycles += FPlatformTime::Cycles64() - StartCycles;
+		MinAllocations = FMath::Min(MinAllocations, FNavAwareAllocationCounter::Read() - StartAllocations);
+	}
+
+	const double Seconds = FPlatformTime::ToSeconds64(Cycles);
+	OutResult.NsPerEdge = Seconds * 1e9 / (static_cast<double>(Iterations) * FMath::Max(NumEdges, 1));
+	OutResult.AllocsPerRun = Iterations > 0 ? MinAllocations : 0.0;
+}
+
+
+/*
+ * Share of origins spread evenly over every baked cell at its bake height that the baked data serves, per tolerance scale.
+ * Cells nothing was baked for, e.g. off the navmesh, are not sampled
+ */
+static void MeasureBakedHitRate(const FString& Path, int32 SamplesPerCell)
+{
+	FNavAwareBakedData BakedData;
+	if (!BakedData.Load(Path))
+	{
+		UE_LOG(NavAware, Error, TEXT("No valid baked awareness data at %s"), *Path)
+		return;
+	}
+
+	const FNavAwareBakeHeader* Header = BakedData.GetHeader();
+	const float ConfiguredScale = GetDefault<UNavAwareCacheSubsystem>()->GetBakedOriginToleranceScale();
+	TArray<float> Scales = { 0.25f, 0.5f, 0.75f, 1.f, 1.5f };
+	Scales.AddUnique(ConfiguredScale);
+	Scales.Sort();
+
+	FRandomStream Stream(Header->NumCells);
+	FNavAwareResult Result;
+	UE_LOG(NavAware, Display, TEXT("Baked hit rate of %s, %u cells of %.0f, %d samples each"), *Path, Header->NumCells, Header->CellSize, SamplesPerCell)
+	for (const float Scale : Scales)
+	{
+		int64 NumSamples = 0;
+		int64 NumHits = 0;
+		for (uint32 CellIndex = 0; CellIndex < Header->NumCells; CellIndex++)
+		{
+			const FNavAwareBakedCell& Cell = BakedData.GetCell(CellIndex);
+			const FVector CellMin = FNavAwareBakedData::GetCellMin(Cell.Key, Header->CellSize);
+			const double Height = BakedData.GetCellOrigin(Cell).Z;
+			for (int32 i = 0; i < SamplesPerCell; i++)
+			{
+				const FVector Origin(CellMin.X + Stream.FRand() * Header->CellSize, CellMin.Y + Stream.FRand() * Header->CellSize, Height);
+				NumHits += BakedData.FindResult(Origin, Scale * Header->CellSize, Result) ? 1 : 0;
+				NumSamples++;
+			}
+		}
+		
+		UE_LOG(NavAware, Display, TEXT("  scale %.2f: %5.1f%% served%s"), Scale, NumSamples > 0 ? 100.0 * NumHits / NumSamples : 0.0,
+			Scale == ConfiguredScale ? TEXT(" (configured)") : TEXT(""))
+	}
+}
+
+/*Entries of both results as (corner edge, target edge) pairs, line ids may differ between runs and are compared through the edges*/
+static bool HaveSameEntries(const FNavAwareResult& A, const FNavAwareResult& B)
+{
+	if (A.Entries.Num() != B.Entries.Num() || A.WallEdges.Num() != B.WallEdges.Num()) return false;
+
+	TSet<TPair<int32, int32>> EntriesOfA;
+	for (const FEntry& Entry : A.Entries)
+	{
+		EntriesOfA.Add({ Entry.EdgeA, Entry.EdgeB });
+	}
+	for (const FEntry& Entry : B.Entries)
+	{
+		if (!EntriesOfA.Contains({ Entry.EdgeA, Entry.EdgeB }) || A.WallEdges[Entry.EdgeB].LineID != Entry.TargetLineID) return false;
+	}
+	return true;
+}
+
+/*
+ * bIncrementalUpdate must return what a full run does; the diff against Before here renumbers lines far from every corner
+ */
+static bool VerifyIncrementalUpdate(ANavAwareEnhancedBase& Pipeline)
+{
+	FNavAwareEdgeFixture Before, After;
+	FNavAwareEdgeFixture::MakeDistantMerge(1, Before, After);
+	const FVector Origin = FVector::ZeroVector;
+	const float Radius = 10000.f;
+
+	FNavAwareResult Full;
+	FNavAwarePipelineStages::ClassifyEdges(Pipeline, After.Edges, Origin, Radius, Full);
+
+	FNavAwareIncrementalState Incremental;
+	FNavAwareResult Result;
+	FNavAwarePipelineStages::ClassifyEdges(Pipeline, Before.Edges, Origin, Radius, Result, &Incremental);
+	FNavAwarePipelineStages::ClassifyEdges(Pipeline, After.Edges, Origin, Radius, Result, &Incremental);
+
+	if (!HaveSameEntries(Full, Result))
+	{
+		UE_LOG(NavAware, Error, TEXT("Incremental update of %s differs from a full run: %d entries instead of %d"), *After.Name, Result.Entries.Num(), Full.Entries.Num())
+		return false;
+	}
+	UE_LOG(NavAware, Display, TEXT("Incremental update of %s matches a full run, %d entries"), *After.Name, Full.Entries.Num())
+	return true;
+}
+
+int32 UNavAwareBenchmarkCommandlet::Main(const FString& Params)
+{
+	FString BakedPath;
+	if (FParse::Value(*Params, TEXT("baked="), BakedPath))
+	{
+		int32 SamplesPerCell = 64;
+		FParse::Value(*Params, TEXT("bakedsamples="), SamplesPerCell);
+		MeasureBakedHitRate(BakedPath, FMath::Max(SamplesPerCell, 1));
+	}
+	
+	TArray<int32> Sizes = { 10, 50, 100, 500, 1000, 5000 };
+	FString SizesString;
+	if (FParse::Value(*Params, TEXT("sizes="), SizesString, false))
+	{
+		TArray<FString> SizeStrings;
+		SizesString.ParseIntoArray(SizeStrings, TEXT(","));
+		Sizes.Reset();
+		for (const FString& Size : SizeStrings)
+		{
+			Sizes.Add(FMath::Max(FCString::Atoi(*Size), 1));
+		}
+	}
+	
+	int32 Iterations = 50;
+	FParse::Value(*Params, TEXT("iterations="), Iterations);
+	Iterations = FMath::Max(Iterations, 1);
+	
+	FString FixtureDir = FNavAwareEdgeFixture::GetFixtureDir();
+	FParse::Value(*Params, TEXT("fixtures="), FixtureDir);
+	
+	FString CsvPath = FPaths::ProjectSavedDir() / TEXT("NavAware") / TEXT("Benchmark.csv");
+	FParse::Value(*Params, TEXT("csv="), CsvPath);
+
+	/*
+	 * Fixtures: every synthetic shape at every size, then whatever was recorded
+	 */
+	TArray<FNavAwareEdgeFixture> Fixtures;
+	for (const int32 Size : Sizes)
+	{
+		Fixtures.Add(FNavAwareEdgeFixture::MakeCorridor(Size, Size));
+		Fixtures.Add(FNavAwareEdgeFixture::MakeCrossRoads(Size, Size));
+		Fixtures.Add(FNavAwareEdgeFixture::MakeRoomLoops(Size, Size));
+		Fixtures.Add(FNavAwareEdgeFixture::MakeNoisyCurve(Size, Size));
+	}
+	
+	TArray<FString> RecordedFiles;
+	IFileManager::Get().FindFiles(RecordedFiles, *(FixtureDir / TEXT("*.edges")), true, false);
+	for (const FString& File : RecordedFiles)
+	{
+		FNavAwareEdgeFixture Recorded;
+		if (FNavAwareEdgeFixture::Load(FixtureDir / File, Recorded))
+		{
+			Fixtures.Add(MoveTemp(Recorded));
+		}
+	}
+
+	//stages only read their tunables, the default object is as good as a spawned actor and needs no world
+	ANavAwareEnhancedBase* Pipeline = GetMutableDefault<ANavAwareEnhancedBase>();
+	FNavAwarePipelineStages::SnapshotSettings(*Pipeline);
+
+	const bool bIncrementalMatches = VerifyIncrementalUpdate(*Pipeline);
+
+	if (!FNavAwareAllocationCounter::IsSupported())
+	{
+		UE_LOG(NavAware, Warning, TEXT("Allocator %s doesn't count its calls in this build, allocs/run stays 0"), GMalloc->GetDescriptiveName())
+	}
+
+	TArray<FNavAwareStageResult> Results;
+	for (FNavAwareEdgeFixture& Fixture : Fixtures)
+	{
+		const int32 NumEdges = Fixture.Edges.Num();
+		//recorded fixtures are in world space, the first edge stands in for the query origin
+		const FVector Origin = NumEdges > 0 ? Fixture.Edges[0].Start : FVector::ZeroVector;
+		
+		FNavAwareStageInputs Inputs;
+		FNavAwarePipelineStages::GatherEdgesWithSorting(*Pipeline, Fixture.Edges, Origin, Inputs.Gathered);
+		Inputs.Linked = Inputs.Gathered;
+		FNavAwarePipelineStages::EdgeLinker(*Pipeline, Inputs.Linked);
+		Inputs.Marked = Inputs.Linked;
+		FNavAwarePipelineStages::MarkCorner(*Pipeline, Inputs.Marked);
+		Inputs.Filtered = Inputs.Marked;
+		FNavAwarePipelineStages::FilterOnlyInnerEdge(*Pipeline, Inputs.Filtered);
+		Inputs.Classified = Inputs.Filtered;
+		FNavAwarePipelineStages::MarkEntryEdges(*Pipeline, Inputs.Classified);
+		FNavAwarePipelineStages::MakeCornerArray(*Pipeline, Inputs.Classified, Inputs.Corners);
+
+		FNavAwareEdgeStore Edges;
+		TArray<FCorner> Corners;
+		TArray<FEntry> Entries;
+		const auto AddResult = [&](const TCHAR* Stage, bool bNeedsNavMesh = false) -> FNavAwareStageResult&
+		{
+			FNavAwareStageResult& Result = Results.AddDefaulted_GetRef();
+			Result.Fixture = Fixture.Name;
+			Result.NumEdges = NumEdges;
+			Result.Stage = Stage;
+			Result.bNeedsNavMesh = bNeedsNavMesh;
+			return Result;
+		};
+		
+		MeasureStage(Iterations, NumEdges, [&]{ Edges.Reset(); }, [&]{ FNavAwarePipelineStages::GatherEdgesWithSorting(*Pipeline, Fixture.Edges, Origin, Edges); }, AddResult(TEXT("GatherEdgesWithSorting")));
+		MeasureStage(Iterations, NumEdges, [&]{ Edges = Inputs.Gathered; }, [&]{ FNavAwarePipelineStages::EdgeLinker(*Pipeline, Edges); }, AddResult(TEXT("EdgeLinker")));
+		MeasureStage(Iterations, NumEdges, [&]{ Edges = Inputs.Linked; }, [&]{ FNavAwarePipelineStages::MarkCorner(*Pipeline, Edges); }, AddResult(TEXT("MarkCorner")));
+		MeasureStage(Iterations, NumEdges, [&]{ Edges = Inputs.Marked; }, [&]{ FNavAwarePipelineStages::FilterOnlyInnerEdge(*Pipeline, Edges); }, AddResult(TEXT("FilterOnlyInnerEdge"), true));
+		MeasureStage(Iterations, NumEdges, [&]{ Edges = Inputs.Filtered; }, [&]{ FNavAwarePipelineStages::MarkEntryEdges(*Pipeline, Edges); }, AddResult(TEXT("MarkEntryEdges")));
+		MeasureStage(Iterations, NumEdges, [&]{ Corners.Reset(); }, [&]{ FNavAwarePipelineStages::MakeCornerArray(*Pipeline, Inputs.Classified, Corners); }, AddResult(TEXT("MakeCornerArray")));
+		MeasureStage(Iterations, NumEdges, [&]{ Corners = Inputs.Corners; }, [&]{ FNavAwarePipelineStages::TakeSteps(*Pipeline, Inputs.Classified, Corners, Entries); }, AddResult(TEXT("TakeSteps"), true));
+	}
+
+	/*
+	 * Report
+	 */
+	FString Csv = TEXT("Fixture,Edges,Stage,NsPerEdge,AllocsPerRun,Representative\n");
+	UE_LOG(NavAware, Display, TEXT("%-16s %6s %-24s %12s %12s"), TEXT("Fixture"), TEXT("Edges"), TEXT("Stage"), TEXT("ns/edge"), TEXT("allocs/run"))
+	for (const FNavAwareStageResult& Result : Results)
+	{
+		UE_LOG(NavAware, Display, TEXT("%-16s %6d %-24s %12.1f %12.1f%s"), *Result.Fixture, Result.NumEdges, *Result.Stage, Result.NsPerEdge, Result.AllocsPerRun,
+			Result.bNeedsNavMesh ? TEXT(" *") : TEXT(""))
+		Csv += FString::Printf(TEXT("%s,%d,%s,%.2f,%.2f,%d\n"), *Result.Fixture, Result.NumEdges, *Result.Stage, Result.NsPerEdge, Result.AllocsPerRun, Result.bNeedsNavMesh ? 0 : 1);
+	}
+	UE_LOG(NavAware, Display, TEXT("* not representative: without a navmesh FilterOnlyInnerEdge gets a zero poly center for every edge, and TakeSteps walks what that left"))
+
+	if (!FFileHelper::SaveStringToFile(Csv, *CsvPath))
+	{
+		UE_LOG(NavAware, Error, TEXT("Failed writing benchmark results to %s"), *CsvPath)
+		return 1;
+	}
+	UE_LOG(NavAware, Display, TEXT("Benchmark results written to %s"), *CsvPath)
+	
+	return bIncrementalMatches ? 0 : 1;
+}
+#else
+int32 UNavAwareBenchmarkCommandlet::Main(const FString& Params)
+{
+	UE_LOG(NavAware, Error, TEXT("NavAwareBenchmark only runs in editor builds"))
+	return 1;
+}
+#endif
@@ -0,0 +1,134 @@
+﻿#include "Component/NavAwareDebugRenderComponent.h"
+
+
+void FNavAwareDebugShapes::Reset()
+{
+	Lines.Reset();
+	Boxes.Reset();
+	Spheres.Reset();
+	Texts.Reset();
+	Bounds = FBox(ForceInit);
+}
+
+void FNavAwareDebugShapes::AddLine(const FVector& Start, const FVector& End, const FColor& Color, float Thickness)
+{
+	Lines.Emplace(Start, End, Color, Thickness);
+	Bounds += Start;
+	Bounds += End;
+}
+
+void FNavAwareDebugShapes::AddArrow(const FVector& Start, const FVector& End, const FColor& Color, float ArrowSize, float Thickness)
+{
+	AddLine(Start, End, Color, Thickness);
+	
+	//same head as DrawDebugDirectionalArrow: two lines back from the end, sqrt(ArrowSize) along and across the shaft
+	FVector Dir = (End - Start).GetSafeNormal();
+	if (Dir.IsZero()) return;
+	
+	FVector Up(0.f, 0.f, 1.f);
+	FVector Right = Dir ^ Up;
+	if (!Right.IsNormalized())
+	{
+		Dir.FindBestAxisVectors(Up, Right);
+	}
+	const float ArrowSqrt = FMath::Sqrt(ArrowSize);
+	AddLine(End, End - Dir * ArrowSqrt + Right * ArrowSqrt, Color, Thickness);
+	AddLine(End, End - Dir * ArrowSqrt - Right * ArrowSqrt, Color, Thickness);
+}
+
+void FNavAwareDebugShapes::AddBox(const FVector& Center, const FVector& Extent, const FColor& Color)
+{
+	const FBox Box(Center - Extent, Center + Extent);
+	Boxes.Emplace(Box, Color);
+	Bounds += Box;
+}
+
+void FNavAwareDebugShapes::AddSphere(const FVector& Center, float Radius, const FColor& Color)
+{
+	Spheres.Emplace(Radius, Center, Color);
+	Bounds += FBox::BuildAABB(Center, FVector(Radius));
+}
+
+void FNavAwareDebugShapes::AddText(const FVector& Location, const FString& Text, const FColor& Color)
+{
+	Texts.Emplace(Text, Location, Color);
+	Bounds += Location;
+}
+
+
+UNavAwareDebugRenderComponent::UNavAwareDebugRenderComponent()
+{
+	PrimaryComponentTick.bCanEverTick = false;
+	SetCastShadow(false);
+	SetGenerateOverlapEvents(false);
+	SetCollisionEnabled(ECollisionEnabled::NoCollision);
+	bHiddenInGame = false;
+	bSelectable = false;
+}
+
+void UNavAwareDebugRenderComponent::SetAgentShapes(const AActor* Agent, FNavAwareDebugShapes&& Shapes)
+{
+	AgentShapes.FindOrAdd(Agent) = MoveTemp(Shapes);
+	OnShapesChanged();
+}
+
+void UNavAwareDebugRenderComponent::ClearAgent(const AActor* Agent)
+{
+	if (AgentShapes.Remove(Agent) > 0)
+	{
+		OnShapesChanged();
+	}
+}
+
+void UNavAwareDebugRenderComponent::OnShapesChanged()
+{
+	//only flags the component, bounds & proxy are rebuilt once at the end of the frame
+	MarkRenderStateDirty();
+}
+
+#if NAVAWARE_WITH_DEBUG_DRAW
+FDebugRenderSceneProxy* UNavAwareDebugRenderComponent::CreateDebugSceneProxy()
+{
+	FDebugRenderSceneProxy* Proxy = new FDebugRenderSceneProxy(this);
+	Proxy->DrawType = FDebugRenderSceneProxy::WireMesh;
+
+	int32 NumLines = 0, NumBoxes = 0, NumSpheres = 0, NumTexts = 0;
+	for (const auto& [Agent, Shapes] : AgentShapes)
+	{
+		NumLines += Shapes.Lines.Num();
+		NumBoxes += Shapes.Boxes.Num();
+		NumSpheres += Shapes.Spheres.Num();
+		NumTexts += Shapes.Texts.Num();
+	}
+	Proxy->Lines.Reserve(NumLines);
+	Proxy->Boxes.Reserve(NumBoxes);
+	Proxy->Spheres.Reserve(NumSpheres);
+	Proxy->Texts.Reserve(NumTexts);
+	
+	for (const auto& [Agent, Shapes] : AgentShapes)
+	{
+		//agents destroyed without EndPlay, e.g. a streamed out level
+		if (!Agent.IsValid()) continue;
+		
+		Proxy->Lines.Append(Shapes.Lines);
+		Proxy->Boxes.Append(Shapes.Boxes);
+		Proxy->Spheres.Append(Shapes.Spheres);
+		Proxy->Texts.Append(Shapes.Texts);
+	}
+	return Proxy;
+}
+#endif
+
+FBoxSphereBounds UNavAwareDebugRenderComponent::CalcBounds(const FTransform& LocalToWorld) const
+{
+	//shapes are in world space already
+	FBox Bounds(ForceInit);
+	for (const auto& [Agent, Shapes] : AgentShapes)
+	{
+		if (Agent.IsValid())
+		{
+			Bounds += Shapes.Bounds;
+		}
+	}
+	return Bounds.IsValid ? FBoxSphereBounds(Bounds) : FBoxSphereBounds(LocalToWorld.GetLocation(), FVector::ZeroVector, 0.f);
+}
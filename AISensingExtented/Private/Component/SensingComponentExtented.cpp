@@ -1,13 +1,22 @@
 ﻿#include "Component/SensingComponentExtented.h"
 
 #include "AIController.h"
+#include "CollisionQueryParams.h"
+#include "NavigationSystem.h"
+#include "NavigationData.h"
 #include "Components/PawnNoiseEmitterComponent.h"
+#include "Components/SphereComponent.h"
+#include "Subsystem/SensingSchedulerSubsystem.h"
+
+DEFINE_LOG_CATEGORY(SensingExtented);
 
 
 USensingComponentExtented::USensingComponentExtented()
 {
 	PrimaryComponentTick.bCanEverTick = true;
 	GetWorld();
+	
+	LineOfSightTraceDelegate.BindUObject(this, &USensingComponentExtented::OnLineOfSightTraceDone);
 }
 
 
@@ -15,6 +24,42 @@ void USensingComponentExtented::BeginPlay()
 {
 	Super::BeginPlay();
 
+	if (bUseSensingScheduler)
+	{
+		if (USensingSchedulerSubsystem* Scheduler = GetWorld()->GetSubsystem<USensingSchedulerSubsystem>())
+		{
+			bScheduled = true;
+			//InitializeComponent has started the own timer already
+			Super::SetTimer(0.f);
+			Scheduler->RegisterSensor(this);
+		}
+	}
+
+	if (bEventDrivenSensing)
+	{
+		CreateSightVolume();
+	}
+}
+
+void USensingComponentExtented::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	if (bScheduled)
+	{
+		if (USensingSchedulerSubsystem* Scheduler = GetWorld()->GetSubsystem<USensingSchedulerSubsystem>())
+		{
+			Scheduler->UnregisterSensor(this);
+		}
+		bScheduled = false;
+	}
+
+	if (SightVolume)
+	{
+		SightVolume->DestroyComponent();
+		SightVolume = nullptr;
+		Candidates.Reset();
+	}
+	
+	Super::EndPlay(EndPlayReason);
 }
 
 
@@ -25,6 +70,65 @@ void USensingComponentExtented::TickComponent(float DeltaTime, ELevelTick TickTy
 
 }
 
+void USensingComponentExtented::SetTimer(const float TimeDelay)
+{
+	Super::SetTimer(bScheduled ? 0.f : TimeDelay);
+}
+
+int32 USensingComponentExtented::RunSensingPass()
+{
+	UpdateAISensing();
+	return NumLineOfSightChecks;
+}
+
+void USensingComponentExtented::UpdateAISensing()
+{
+	++SensePass;
+	NumLineOfSightChecks = 0;
+
+	USensingSchedulerSubsystem* Scheduler = bUsePawnGrid ? GetWorld()->GetSubsystem<USensingSchedulerSubsystem>() : nullptr;
+	if (SightVolume == nullptr && Scheduler == nullptr)
+	{
+		Super::UpdateAISensing();
+	}
+	else if (CanSenseAnything())
+	{
+		if (SightVolume)
+		{
+			CollectDueCandidates();
+		}
+		else
+		{
+			const float Radius = FMath::Max3(SightRadius, HearingThreshold, LOSHearingThreshold);
+			Scheduler->GetPawnGrid().FindPawnsInCells(GetSensorLocation(), Radius, CandidatePawns);
+		}
+
+		//both only cover the hearing thresholds at loudness 1, around the sensor
+		USensingSchedulerSubsystem* NoiseSource = Scheduler ? Scheduler : GetWorld()->GetSubsystem<USensingSchedulerSubsystem>();
+		if (bHearNoises && NoiseSource)
+		{
+			NoiseSource->GetPawnGrid().AddRecentNoiseMakers(GetWorld()->GetTimeSeconds() - HearingMaxSoundAge, CandidatePawns);
+		}
+		
+		for (APawn* Pawn : CandidatePawns)
+		{
+			if (!IsSensorActor(Pawn))
+			{
+				SensePawn(*Pawn);
+			}
+		}
+	}
+	
+	SweepUnseenPawns();
+	
+	//async traces of this pass come in next frame, its events wait for the last of them
+	bSenseEventsDeferred = PendingTraces.Num() > 0;
+	if (!bSenseEventsDeferred)
+	{
+		FinishSensePass();
+	}
+}
+
 void USensingComponentExtented::SensePawn(APawn& Pawn)
 {
 	// Visibility checks
@@ -34,32 +138,32 @@ void USensingComponentExtented::SensePawn(APawn& Pawn)
 	{
 		if (CouldSeePawn(&Pawn, true))
 		{
-			if (HasLineOfSightTo(&Pawn))
+			//navmesh raycasts are cheap enough to stay synchronous
+			if (bAsyncLineOfSight && LineOfSightMode != ESensingLineOfSightMode::NavMesh)
 			{
-				BroadcastOnSeePawn(Pawn);
-				if (ListOfSeenPawn.Find(&Pawn) == INDEX_NONE)
+				//sight only changes when the trace comes in, until then the filtered result stands
+				bHasSeenPawn = RequestLineOfSight(Pawn);
+				bHasFailedLineOfSightCheck = !bHasSeenPawn;
+				if (FSensedPawnState* State = SeenPawns.Find(&Pawn))
 				{
-					ListOfSeenPawn.Add(&Pawn);
+					State->LastSeenPass = SensePass;
 				}
+			}
+			else if (HasSharedLineOfSightTo(Pawn))
+			{
+				MarkPawnSeen(Pawn);
 				bHasSeenPawn = true;
 			}
 			else
 			{
-				if (ListOfSeenPawn.Find(&Pawn) != INDEX_NONE)
-				{
-					BroadCastUnseenPawn(Pawn);
-					ListOfSeenPawn.Remove(&Pawn);
-				}
+				ForgetPawn(Pawn);
 				bHasFailedLineOfSightCheck = true;
 			}
 		}
 		else
 		{
-            if (ListOfSeenPawn.Find(&Pawn) != INDEX_NONE)
-            {
-				BroadCastUnseenPawn(Pawn);
-            	ListOfSeenPawn.Remove(&Pawn);
-            }
+			ForgetPawn(Pawn);
+			LineOfSightStates.Remove(&Pawn);
 		}
 	}
 
@@ -94,8 +198,445 @@ void USensingComponentExtented::SensePawn(APawn& Pawn)
 	}
 }
 
+void USensingComponentExtented::MarkPawnSeen(APawn& Pawn, bool bBroadcastSeen)
+{
+	if (!bBatchSightEvents && bBroadcastSeen)
+	{
+		BroadcastOnSeePawn(Pawn);
+	}
+	
+	const float Now = GetWorld()->GetTimeSeconds();
+	FSensedPawnState* State = SeenPawns.Find(&Pawn);
+	if (State == nullptr)
+	{
+		State = &SeenPawns.Add(&Pawn);
+		State->FirstSeenTime = Now;
+		if (bBatchSightEvents)
+		{
+			PendingNewlySeen.Add(&Pawn);
+		}
+	}
+	State->LastSeenPass = SensePass;
+	State->LastSeenTime = Now;
+	State->LastKnownLocation = Pawn.GetActorLocation();
+}
+
+bool USensingComponentExtented::RequestLineOfSight(APawn& Pawn)
+{
+	FLineOfSightState& State = LineOfSightStates.FindOrAdd(&Pawn);
+	State.LastSensePass = SensePass;
+	State.LastRequestPass = SensePass;
+	
+	//one trace in flight per pawn, a pass running every frame would otherwise stack them up
+	if (State.bTracePending)
+	{
+		return State.bHasLineOfSight;
+	}
+
+	const FVector SensorLocation = GetSensorLocation();
+	const FVector TargetLocation = Pawn.GetTargetLocation(GetOwner());
+	const double Now = GetWorld()->GetTimeSeconds();
+	FSensingLineOfSightCache* Cache = GetLineOfSightCache();
+	const FSensingLineOfSightKey Key = Cache ? Cache->MakeKey(SensorLocation, TargetLocation, static_cast<uint8>(LineOfSightMode)) : FSensingLineOfSightKey();
+
+	//answered already, by another sensor or, when blocked on the navmesh, without any trace
+	bool bHasLineOfSight = false;
+	bool bAnswered = Cache && Cache->Find(Key, Now, bHasLineOfSight);
+	if (!bAnswered && LineOfSightMode == ESensingLineOfSightMode::NavMeshThenPhysics && !HasNavMeshLineOfSightTo(Pawn))
+	{
+		++NumLineOfSightChecks;
+		bAnswered = true;
+		if (Cache)
+		{
+			Cache->Store(Key, Now, false);
+		}
+	}
+	
+	if (bAnswered)
+	{
+		if (FilterLineOfSight(State, bHasLineOfSight))
+		{
+			MarkPawnSeen(Pawn, false);
+		}
+		else
+		{
+			ForgetPawn(Pawn);
+		}
+		return State.bHasLineOfSight;
+	}
+	
+	++NumLineOfSightChecks;
+	const uint32 Ticket = ++NextTraceTicket;
+	GetWorld()->AsyncLineTraceByChannel(EAsyncTraceType::Single, SensorLocation, TargetLocation, ECC_Visibility,
+		MakeLineOfSightParams(Pawn), FCollisionResponseParams::DefaultResponseParam, &LineOfSightTraceDelegate, Ticket);
+	
+	PendingTraces.Add(Ticket, { &Pawn, Key, Cache != nullptr });
+	State.bTracePending = true;
+	return State.bHasLineOfSight;
+}
+
+void USensingComponentExtented::OnLineOfSightTraceDone(const FTraceHandle& Handle, FTraceDatum& Datum)
+{
+	FPendingLineOfSightTrace Trace;
+	if (!PendingTraces.RemoveAndCopyValue(Datum.UserData, Trace)) return;
+
+	const bool bTraceHasLineOfSight = !(Datum.OutHits.Num() > 0 && Datum.OutHits[0].bBlockingHit);
+	if (Trace.bShared)
+	{
+		if (FSensingLineOfSightCache* Cache = GetLineOfSightCache())
+		{
+			Cache->Store(Trace.Key, GetWorld()->GetTimeSeconds(), bTraceHasLineOfSight);
+		}
+	}
+	
+	const TWeakObjectPtr<APawn>& WeakPawn = Trace.Pawn;
+	APawn* Pawn = WeakPawn.Get();
+	FLineOfSightState* State = LineOfSightStates.Find(WeakPawn);
+	if (State && State->LastSensePass != SensePass)
+	{
+		//left the candidates while the trace was in flight, the sweep has dealt with it
+		LineOfSightStates.Remove(WeakPawn);
+	}
+	else if (Pawn && State)
+	{
+		State->bTracePending = false;
+		
+		if (FilterLineOfSight(*State, bTraceHasLineOfSight))
+		{
+			MarkPawnSeen(*Pawn, false);
+		}
+		else
+		{
+			ForgetPawn(*Pawn);
+		}
+	}
+
+	//the pass is done once its last trace is in
+	if (bSenseEventsDeferred && PendingTraces.Num() == 0)
+	{
+		bSenseEventsDeferred = false;
+		FinishSensePass();
+	}
+}
+
+bool USensingComponentExtented::FilterLineOfSight(FLineOfSightState& State, bool bRawLineOfSight) const
+{
+	if (!State.bHasResult || bRawLineOfSight == State.bHasLineOfSight)
+	{
+		State.bHasLineOfSight = bRawLineOfSight;
+		State.bHasResult = true;
+		State.DisagreeingTraces = 0;
+	}
+	else if (++State.DisagreeingTraces >= LineOfSightHysteresis)
+	{
+		State.bHasLineOfSight = bRawLineOfSight;
+		State.DisagreeingTraces = 0;
+	}
+	return State.bHasLineOfSight;
+}
+
+bool USensingComponentExtented::HasLineOfSightWithMode(const APawn& Pawn, ESensingLineOfSightMode Mode) const
+{
+	switch (Mode)
+	{
+	case ESensingLineOfSightMode::NavMesh:
+		return HasNavMeshLineOfSightTo(Pawn);
+		
+	case ESensingLineOfSightMode::NavMeshThenPhysics:
+		return HasNavMeshLineOfSightTo(Pawn) && HasTraceLineOfSightTo(Pawn);
+		
+	case ESensingLineOfSightMode::Physics:
+		default:
+		return HasLineOfSightTo(&Pawn);
+	}
+}
+
+bool USensingComponentExtented::HasSharedLineOfSightTo(const APawn& Pawn)
+{
+	FSensingLineOfSightCache* Cache = GetLineOfSightCache();
+	if (Cache == nullptr)
+	{
+		++NumLineOfSightChecks;
+		return HasLineOfSightWithMode(Pawn, LineOfSightMode);
+	}
+
+	const double Now = GetWorld()->GetTimeSeconds();
+	const FSensingLineOfSightKey Key = Cache->MakeKey(GetSensorLocation(), Pawn.GetTargetLocation(GetOwner()), static_cast<uint8>(LineOfSightMode));
+	
+	bool bHasLineOfSight = false;
+	if (!Cache->Find(Key, Now, bHasLineOfSight))
+	{
+		++NumLineOfSightChecks;
+		bHasLineOfSight = HasLineOfSightWithMode(Pawn, LineOfSightMode);
+		Cache->Store(Key, Now, bHasLineOfSight);
+	}
+	return bHasLineOfSight;
+}
+
+FSensingLineOfSightCache* USensingComponentExtented::GetLineOfSightCache() const
+{
+	if (!bUseLineOfSightCache) return nullptr;
+	
+	USensingSchedulerSubsystem* Scheduler = GetWorld()->GetSubsystem<USensingSchedulerSubsystem>();
+	return Scheduler ? &Scheduler->GetLineOfSightCache() : nullptr;
+}
+
+bool USensingComponentExtented::HasNavMeshLineOfSightTo(const APawn& Pawn) const
+{
+	const ANavigationData* NavData = GetSensingNavData();
+	if (NavData == nullptr)
+	{
+		return HasLineOfSightTo(&Pawn);
+	}
+
+	const APawn* OwnerPawn = Cast<APawn>(GetOwner());
+	const FVector Start = OwnerPawn ? OwnerPawn->GetNavAgentLocation() : GetOwner()->GetActorLocation();
+	
+	//Raycast returns true when it hits the navmesh boundary
+	FVector HitLocation;
+	return !NavData->Raycast(Start, Pawn.GetNavAgentLocation(), HitLocation, NavData->GetDefaultQueryFilter(), GetOwner());
+}
+
+bool USensingComponentExtented::HasTraceLineOfSightTo(const APawn& Pawn) const
+{
+	return !GetWorld()->LineTraceTestByChannel(GetSensorLocation(), Pawn.GetTargetLocation(GetOwner()), ECC_Visibility, MakeLineOfSightParams(Pawn));
+}
+
+FCollisionQueryParams USensingComponentExtented::MakeLineOfSightParams(const APawn& Pawn) const
+{
+	FCollisionQueryParams Params(SCENE_QUERY_STAT(SensingLineOfSight), true, GetOwner());
+	Params.AddIgnoredActor(&Pawn);
+	return Params;
+}
+
+const ANavigationData* USensingComponentExtented::GetSensingNavData() const
+{
+	if (!SensingNavData.IsValid())
+	{
+		if (const UNavigationSystemV1* NavSystem = FNavigationSystem::GetCurrent<UNavigationSystemV1>(GetWorld()))
+		{
+			//the navmesh built for the owner's agent size, the default one when there is none
+			const APawn* OwnerPawn = Cast<APawn>(GetOwner());
+			const ANavigationData* NavData = OwnerPawn ? NavSystem->GetNavDataForProps(OwnerPawn->GetNavAgentPropertiesRef()) : nullptr;
+			SensingNavData = NavData ? NavData : NavSystem->GetDefaultNavDataInstance();
+		}
+	}
+	return SensingNavData.Get();
+}
+
+void USensingComponentExtented::CreateSightVolume()
+{
+	AActor* Owner = GetOwner();
+	if (Owner == nullptr || Owner->GetRootComponent() == nullptr) return;
+	
+	SightVolume = NewObject<USphereComponent>(Owner, TEXT("SensingSightVolume"), RF_Transient);
+	SightVolume->InitSphereRadius(FMath::Max3(SightRadius, HearingThreshold, LOSHearingThreshold));
+	SightVolume->SetCollisionEnabled(ECollisionEnabled::QueryOnly);
+	SightVolume->SetCollisionResponseToAllChannels(ECR_Ignore);
+	SightVolume->SetCollisionResponseToChannel(ECC_Pawn, ECR_Overlap);
+	SightVolume->SetGenerateOverlapEvents(true);
+	SightVolume->SetCanEverAffectNavigation(false);
+	SightVolume->SetupAttachment(Owner->GetRootComponent());
+	SightVolume->OnComponentBeginOverlap.AddDynamic(this, &USensingComponentExtented::OnSightVolumeBeginOverlap);
+	SightVolume->OnComponentEndOverlap.AddDynamic(this, &USensingComponentExtented::OnSightVolumeEndOverlap);
+	SightVolume->RegisterComponent();
+
+	//begin overlap only fires for what enters from now on
+	TArray<AActor*> Overlapping;
+	SightVolume->UpdateOverlaps();
+	SightVolume->GetOverlappingActors(Overlapping, APawn::StaticClass());
+	for (AActor* Actor : Overlapping)
+	{
+		if (Actor != Owner)
+		{
+			Candidates.FindOrAdd(CastChecked<APawn>(Actor));
+		}
+	}
+	
+	LastSensorLocation = GetSensorLocation();
+	LastSensorRotation = GetSensorRotation();
+}
+
+void USensingComponentExtented::CollectDueCandidates()
+{
+	CandidatePawns.Reset();
+	
+	const FVector SensorLocation = GetSensorLocation();
+	const FRotator SensorRotation = GetSensorRotation();
+	const bool bSensorMoved = FVector::DistSquared(SensorLocation, LastSensorLocation) > FMath::Square(CandidateMoveThreshold)
+		|| !SensorRotation.Equals(LastSensorRotation, 5.f);
+	if (bSensorMoved)
+	{
+		LastSensorLocation = SensorLocation;
+		LastSensorRotation = SensorRotation;
+	}
+
+	const double Now = GetWorld()->GetTimeSeconds();
+	for (auto It = Candidates.CreateIterator(); It; ++It)
+	{
+		APawn* Pawn = It.Key().Get();
+		if (Pawn == nullptr)
+		{
+			It.RemoveCurrent();
+			continue;
+		}
+
+		FSensingCandidate& Candidate = It.Value();
+		const FVector Location = Pawn->GetActorLocation();
+		
+		//a noise has to be heard before it gets older than HearingMaxSoundAge, standing still or not
+		const UPawnNoiseEmitterComponent* NoiseEmitter = bHearNoises ? Pawn->GetPawnNoiseEmitterComponent() : nullptr;
+		const bool bMadeNoise = NoiseEmitter && FMath::Max(NoiseEmitter->GetLastNoiseTime(true), NoiseEmitter->GetLastNoiseTime(false)) > Candidate.LastSensedTime;
+		
+		if (bSensorMoved || Candidate.bEntered || bMadeNoise || Now - Candidate.LastSensedTime > CandidateStaleTime
+			|| FVector::DistSquared(Location, Candidate.LastSensedLocation) > FMath::Square(CandidateMoveThreshold))
+		{
+			Candidate.LastSensedLocation = Location;
+			Candidate.LastSensedTime = Now;
+			Candidate.bEntered = false;
+			CandidatePawns.Add(Pawn);
+			continue;
+		}
+
+		//nothing changed about it, neither does its sight
+		if (FSensedPawnState* State = SeenPawns.Find(It.Key()))
+		{
+			State->LastSeenPass = SensePass;
+		}
+		if (FLineOfSightState* State = LineOfSightStates.Find(It.Key()))
+		{
+			State->LastSensePass = SensePass;
+		}
+	}
+}
+
+void USensingComponentExtented::OnSightVolumeBeginOverlap(UPrimitiveComponent* OverlappedComponent, AActor* OtherActor, UPrimitiveComponent* OtherComp, int32 OtherBodyIndex, bool bFromSweep, const FHitResult& SweepResult)
+{
+	APawn* Pawn = Cast<APawn>(OtherActor);
+	if (Pawn && Pawn != GetOwner())
+	{
+		Candidates.FindOrAdd(Pawn).bEntered = true;
+	}
+}
+
+void USensingComponentExtented::OnSightVolumeEndOverlap(UPrimitiveComponent* OverlappedComponent, AActor* OtherActor, UPrimitiveComponent* OtherComp, int32 OtherBodyIndex)
+{
+	//pawns with several colliding components only leave with the last of them
+	APawn* Pawn = Cast<APawn>(OtherActor);
+	if (Pawn && !SightVolume->IsOverlappingActor(Pawn))
+	{
+		//left pawns aren't refreshed by the next pass, the sweep unsees them
+		Candidates.Remove(Pawn);
+	}
+}
+
 void USensingComponentExtented::BroadCastUnseenPawn(APawn& Pawn)
 {
+	if (bBatchSightEvents)
+	{
+		PendingUnseen.Add(&Pawn);
+		return;
+	}
 	UnSeePawn.Broadcast(&Pawn);
 }
 
+void USensingComponentExtented::BroadcastSightChanges()
+{
+	if (PendingNewlySeen.Num() == 0 && PendingUnseen.Num() == 0) return;
+
+	//swapped out, a listener may toggle batching or sense again right from the delegate
+	TArray<APawn*> NewlySeen = MoveTemp(PendingNewlySeen);
+	TArray<APawn*> Unseen = MoveTemp(PendingUnseen);
+	OnSightChanged.Broadcast(NewlySeen, Unseen);
+}
+
+void USensingComponentExtented::FinishSensePass()
+{
+	if (!bBatchSightEvents)
+	{
+		//collected first, listeners may well start or stop sensing from the delegate
+		TArray<APawn*, TInlineAllocator<8>> Seen;
+		for (const auto& [WeakPawn, State] : LineOfSightStates)
+		{
+			APawn* Pawn = WeakPawn.Get();
+			if (Pawn && State.LastRequestPass == SensePass && State.bHasLineOfSight && SeenPawns.Contains(WeakPawn))
+			{
+				Seen.Add(Pawn);
+			}
+		}
+
+		for (APawn* Pawn : Seen)
+		{
+			BroadcastOnSeePawn(*Pawn);
+		}
+	}
+	
+	BroadcastSightChanges();
+}
+
+void USensingComponentExtented::ForgetPawn(APawn& Pawn)
+{
+	if (SeenPawns.Remove(&Pawn) > 0)
+	{
+		BroadCastUnseenPawn(Pawn);
+	}
+}
+
+void USensingComponentExtented::SweepUnseenPawns()
+{
+	//collected first, listeners may well start or stop sensing from the delegate
+	TArray<APawn*, TInlineAllocator<8>> Unseen;
+	for (auto It = LineOfSightStates.CreateIterator(); It; ++It)
+	{
+		if (It.Value().LastSensePass != SensePass && !It.Value().bTracePending)
+		{
+			It.RemoveCurrent();
+		}
+	}
+	
+	for (auto It = SeenPawns.CreateIterator(); It; ++It)
+	{
+		if (It.Value().LastSeenPass == SensePass) continue;
+		
+		//a pawn destroyed since its last sighting is still worth an UnSeePawn while it is around
+		if (APawn* Pawn = It.Key().Get(true))
+		{
+			Unseen.Add(Pawn);
+		}
+		It.RemoveCurrent();
+	}
+	
+	for (APawn* Pawn : Unseen)
+	{
+		BroadCastUnseenPawn(*Pawn);
+	}
+}
+
+bool USensingComponentExtented::IsPawnSeen(APawn* Pawn) const
+{
+	return SeenPawns.Contains(Pawn);
+}
+
+bool USensingComponentExtented::GetSensedPawnState(APawn* Pawn, FSensedPawnState& OutState) const
+{
+	if (const FSensedPawnState* State = SeenPawns.Find(Pawn))
+	{
+		OutState = *State;
+		return true;
+	}
+	return false;
+}
+
+TArray<APawn*> USensingComponentExtented::GetSeenPawns() const
+{
+	TArray<APawn*> Pawns;
+	Pawns.Reserve(SeenPawns.Num());
+	for (const auto& [Pawn, State] : SeenPawns)
+	{
+		if (Pawn.IsValid())
+		{
+			Pawns.Add(Pawn.Get());
+		}
+	}
+	return Pawns;
+}
@@ -0,0 +1,85 @@
+﻿#include "Component/SensingComponentExtented.h"
+
+#include "EngineUtils.h"
+#include "UObject/UObjectIterator.h"
+#include "GameFramework/Pawn.h"
+
+#if !UE_BUILD_SHIPPING
+
+/*
+ * Times every line of sight mode over the same sensor/pawn pairs of the running world,
+ * reports the cost per check and how often each mode agrees with Physics
+ */
+static void BenchmarkSensingLineOfSight(const TArray<FString>& Args, UWorld* World)
+{
+	const int32 Iterations = Args.Num() > 0 ? FMath::Max(1, FCString::Atoi(*Args[0])) : 100;
+
+	//every sensor against every pawn within its sight radius
+	TArray<TPair<const USensingComponentExtented*, const APawn*>> Pairs;
+	for (TObjectIterator<USensingComponentExtented> It; It; ++It)
+	{
+		const USensingComponentExtented* Sensor = *It;
+		if (Sensor->GetWorld() != World || Sensor->GetOwner() == nullptr) continue;
+		
+		const FVector SensorLocation = Sensor->GetSensorLocation();
+		for (TActorIterator<APawn> PawnIt(World); PawnIt; ++PawnIt)
+		{
+			if (*PawnIt != Sensor->GetOwner() && FVector::DistSquared(PawnIt->GetActorLocation(), SensorLocation) <= FMath::Square(Sensor->SightRadius))
+			{
+				Pairs.Emplace(Sensor, *PawnIt);
+			}
+		}
+	}
+	
+	if (Pairs.Num() == 0)
+	{
+		UE_LOG(SensingExtented, Warning, TEXT("Sensing.BenchmarkLineOfSight: no pawn within sight radius of any USensingComponentExtented"))
+		return;
+	}
+
+	const ESensingLineOfSightMode Modes[] = { ESensingLineOfSightMode::Physics, ESensingLineOfSightMode::NavMesh, ESensingLineOfSightMode::NavMeshThenPhysics };
+	TArray<bool> PhysicsResults;
+	
+	UE_LOG(SensingExtented, Display, TEXT("Sensing.BenchmarkLineOfSight: %d pairs x %d iterations"), Pairs.Num(), Iterations)
+	UE_LOG(SensingExtented, Display, TEXT("%-20s %12s %10s %10s"), TEXT("Mode"), TEXT("ns/check"), TEXT("visible"), TEXT("agree"))
+	for (const ESensingLineOfSightMode Mode : Modes)
+	{
+		TArray<bool> Results;
+		Results.SetNumUninitialized(Pairs.Num());
+		
+		const uint64 StartCycles = FPlatformTime::Cycles64();
+		for (int32 Iteration = 0; Iteration < Iterations; Iteration++)
+		{
+			for (int32 i = 0; i < Pairs.Num(); i++)
+			{
+				Results[i] = Pairs[i].Key->HasLineOfSightWithMode(*Pairs[i].Value, Mode);
+			}
+		}
+		const double Seconds = FPlatformTime::ToSeconds64(FPlatformTime::Cycles64() - StartCycles);
+		
+		if (Mode == ESensingLineOfSightMode::Physics)
+		{
+			PhysicsResults = Results;
+		}
+		
+		int32 NumVisible = 0, NumAgree = 0;
+		for (int32 i = 0; i < Pairs.Num(); i++)
+		{
+			NumVisible += Results[i] ? 1 : 0;
+			NumAgree += Results[i] == PhysicsResults[i] ? 1 : 0;
+		}
+		
+		UE_LOG(SensingExtented, Display, TEXT("%-20s %12.1f %9.1f%% %9.1f%%"),
+			*UEnum::GetDisplayValueAsText(Mode).ToString(),
+			Seconds * 1e9 / (static_cast<double>(Iterations) * Pairs.Num()),
+			100.0 * NumVisible / Pairs.Num(),
+			100.0 * NumAgree / Pairs.Num())
+	}
+}
+
+static FAutoConsoleCommandWithWorldAndArgs CmdBenchmarkSensingLineOfSight(
+	TEXT("Sensing.BenchmarkLineOfSight"),
+	TEXT("Sensing.BenchmarkLineOfSight [Iterations=100]: times the line of sight modes of USensingComponentExtented in this world"),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateStatic(&BenchmarkSensingLineOfSight));
+
+#endif
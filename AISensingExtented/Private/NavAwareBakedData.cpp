@@ -0,0 +1,299 @@
+﻿#include "NavAwareBakedData.h"
+
+#include "Async/MappedFileHandle.h"
+#include "HAL/PlatformFileManager.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "Misc/PackageName.h"
+#include "Engine/World.h"
+
+static_assert(std::is_trivially_copyable_v<FNavAwareBakedCell> && std::is_trivially_copyable_v<FNavAwareBakedEdge>
+	&& std::is_trivially_copyable_v<FNavAwareBakedCorner> && std::is_trivially_copyable_v<FNavAwareBakedEntry>, "Baked records must stay plain data");
+static_assert(sizeof(FNavAwareBakeHeader) % 4 == 0 && sizeof(FNavAwareBakedCell) % 4 == 0 && sizeof(FNavAwareBakedEdge) % 4 == 0
+	&& sizeof(FNavAwareBakedCorner) % 4 == 0 && sizeof(FNavAwareBakedEntry) % 4 == 0, "Baked records must keep 4 byte alignment");
+
+static FORCEINLINE bool CellKeyLess(const FIntVector& A, const FIntVector& B)
+{
+	if (A.X != B.X) return A.X < B.X;
+	if (A.Y != B.Y) return A.Y < B.Y;
+	return A.Z < B.Z;
+}
+
+/*First + Num within Total, computed wide so a corrupt count can't wrap around*/
+static FORCEINLINE bool IsRangeValid(uint32 First, uint32 Num, uint32 Total)
+{
+	return static_cast<uint64>(First) + Num <= Total;
+}
+
+/*Cell local edge index, INDEX_NONE allowed for links*/
+static FORCEINLINE bool IsEdgeValid(int32 Edge, uint32 NumEdges, bool bAllowNone)
+{
+	return (bAllowNone && Edge == INDEX_NONE) || (Edge >= 0 && static_cast<uint32>(Edge) < NumEdges);
+}
+
+
+FNavAwareBakedData::FNavAwareBakedData() = default;
+
+FNavAwareBakedData::~FNavAwareBakedData()
+{
+	Unload();
+}
+
+FString FNavAwareBakedData::GetBakedDataPath(const UWorld* World)
+{
+	const FString MapName = FPackageName::GetShortName(UWorld::RemovePIEPrefix(World->GetOutermost()->GetName()));
+	return FPaths::ProjectContentDir() / TEXT("NavAware") / MapName + TEXT(".navaware");
+}
+
+bool FNavAwareBakedData::Load(const FString& Path)
+{
+	Unload();
+	
+	IPlatformFile& PlatformFile = FPlatformFileManager::Get().GetPlatformFile();
+	if (!PlatformFile.FileExists(*Path)) return false;
+	
+	MappedHandle.Reset(PlatformFile.OpenMapped(*Path));
+	if (MappedHandle)
+	{
+		MappedRegion.Reset(MappedHandle->MapRegion(0, MappedHandle->GetFileSize()));
+	}
+	
+	if (MappedRegion)
+	{
+		if (BindView(MappedRegion->GetMappedPtr(), MappedRegion->GetMappedSize()))
+		{
+			return true;
+		}
+	}
+	else if (FFileHelper::LoadFileToArray(LoadedBytes, *Path))
+	{
+		if (BindView(LoadedBytes.GetData(), LoadedBytes.Num()))
+		{
+			return true;
+		}
+	}
+	
+	UE_LOG(NavAware, Warning, TEXT("Baked awareness data at %s is invalid, ignored"), *Path)
+	Unload();
+	return false;
+}
+
+void FNavAwareBakedData::Unload()
+{
+	Header = nullptr;
+	Cells = nullptr;
+	Edges = nullptr;
+	Corners = nullptr;
+	Entries = nullptr;
+	
+	//region has to go before its handle
+	MappedRegion.Reset();
+	MappedHandle.Reset();
+	LoadedBytes.Empty();
+}
+
+bool FNavAwareBakedData::BindView(const uint8* Data, int64 Size)
+{
+	if (Data == nullptr || Size < static_cast<int64>(sizeof(FNavAwareBakeHeader))) return false;
+
+	const FNavAwareBakeHeader* InHeader = reinterpret_cast<const FNavAwareBakeHeader*>(Data);
+	if (InHeader->Magic != NavAwareBakeMagic || InHeader->Version != NavAwareBakeVersion || InHeader->CellSize <= 0.f)
+	{
+		return false;
+	}
+
+	const int64 ExpectedSize = sizeof(FNavAwareBakeHeader)
+		+ sizeof(FNavAwareBakedCell) * static_cast<int64>(InHeader->NumCells)
+		+ sizeof(FNavAwareBakedEdge) * static_cast<int64>(InHeader->NumEdges)
+		+ sizeof(FNavAwareBakedCorner) * static_cast<int64>(InHeader->NumCorners)
+		+ sizeof(FNavAwareBakedEntry) * static_cast<int64>(InHeader->NumEntries);
+	if (Size < ExpectedSize) return false;
+
+	const uint8* Cursor = Data + sizeof(FNavAwareBakeHeader);
+	Cells = reinterpret_cast<const FNavAwareBakedCell*>(Cursor);
+	Cursor += sizeof(FNavAwareBakedCell) * InHeader->NumCells;
+	Edges = reinterpret_cast<const FNavAwareBakedEdge*>(Cursor);
+	Cursor += sizeof(FNavAwareBakedEdge) * InHeader->NumEdges;
+	Corners = reinterpret_cast<const FNavAwareBakedCorner*>(Cursor);
+	Cursor += sizeof(FNavAwareBakedCorner) * InHeader->NumCorners;
+	Entries = reinterpret_cast<const FNavAwareBakedEntry*>(Cursor);
+
+	//checked once here, so FindResult can trust every range and index of a cell
+	for (uint32 CellIndex = 0; CellIndex < InHeader->NumCells; CellIndex++)
+	{
+		const FNavAwareBakedCell& Cell = Cells[CellIndex];
+		if (CellIndex > 0 && !CellKeyLess(Cells[CellIndex - 1].Key, Cell.Key)) return false;
+		if (!IsRangeValid(Cell.FirstEdge, Cell.NumEdges, InHeader->NumEdges)
+			|| !IsRangeValid(Cell.FirstCorner, Cell.NumCorners, InHeader->NumCorners)
+			|| !IsRangeValid(Cell.FirstEntry, Cell.NumEntries, InHeader->NumEntries))
+		{
+			return false;
+		}
+
+		for (uint32 i = 0; i < Cell.NumEdges; i++)
+		{
+			const FNavAwareBakedEdge& Edge = Edges[Cell.FirstEdge + i];
+			if (!IsEdgeValid(Edge.PrevEdge, Cell.NumEdges, true) || !IsEdgeValid(Edge.NextEdge, Cell.NumEdges, true)
+				|| Edge.Type > static_cast<uint8>(EWallType::Entry))
+			{
+				return false;
+			}
+		}
+		for (uint32 i = 0; i < Cell.NumCorners; i++)
+		{
+			const FNavAwareBakedCorner& Corner = Corners[Cell.FirstCorner + i];
+			if (!IsEdgeValid(Corner.CornerStart, Cell.NumEdges, false) || !IsEdgeValid(Corner.CornerEnd, Cell.NumEdges, false)) return false;
+		}
+		for (uint32 i = 0; i < Cell.NumEntries; i++)
+		{
+			const FNavAwareBakedEntry& Entry = Entries[Cell.FirstEntry + i];
+			if (!IsEdgeValid(Entry.EdgeA, Cell.NumEdges, false) || !IsEdgeValid(Entry.EdgeB, Cell.NumEdges, false)) return false;
+		}
+	}
+	
+	Header = InHeader;
+	return true;
+}
+
+bool FNavAwareBakedData::FindResult(const FVector& Origin, float MaxOriginDistance, FNavAwareResult& OutResult) const
+{
+	if (!IsLoaded()) return false;
+
+	const FIntVector Key = GetCellKey(Origin, Header->CellSize);
+
+	//binary search over sorted cells
+	int32 Low = 0;
+	int32 High = static_cast<int32>(Header->NumCells);
+	while (Low < High)
+	{
+		const int32 Mid = Low + (High - Low) / 2;
+		if (CellKeyLess(Cells[Mid].Key, Key))
+		{
+			Low = Mid + 1;
+		}
+		else
+		{
+			High = Mid;
+		}
+	}
+	if (Low >= static_cast<int32>(Header->NumCells) || Cells[Low].Key != Key) return false;
+
+	const FNavAwareBakedCell& Cell = Cells[Low];
+	const FVector CellOrigin = GetCellOrigin(Cell);
+	
+	//the cell's result is only what a query from its bake origin returns
+	if (FVector::DistSquared(CellOrigin, Origin) > FMath::Square(MaxOriginDistance)) return false;
+	
+	OutResult.Reset();
+
+	//indices are local to the cell, which is also how they are used in a result
+	OutResult.WallEdges.Reserve(Cell.NumEdges);
+	for (uint32 i = 0; i < Cell.NumEdges; i++)
+	{
+		const FNavAwareBakedEdge& Baked = Edges[Cell.FirstEdge + i];
+		OutResult.WallEdges.Add(FNavPoint(CellOrigin + FVector(Baked.Start), CellOrigin + FVector(Baked.End), static_cast<int32>(i), Baked.LineID, static_cast<EWallType>(Baked.Type), 0.f, Baked.PrevEdge, Baked.NextEdge));
+	}
+	ANavAwareEnhancedBase::FillEdgeDegrees(OutResult.WallEdges);
+
+	OutResult.Corners.Reserve(Cell.NumCorners);
+	for (uint32 i = 0; i < Cell.NumCorners; i++)
+	{
+		const FNavAwareBakedCorner& Baked = Corners[Cell.FirstCorner + i];
+		OutResult.Corners.Add(FCorner(Baked.CornerStart, Baked.CornerEnd, static_cast<int32>(Baked.CornerID)));
+	}
+
+	OutResult.Entries.SetNum(Cell.NumEntries);
+	for (uint32 i = 0; i < Cell.NumEntries; i++)
+	{
+		const FNavAwareBakedEntry& Baked = Entries[Cell.FirstEntry + i];
+		FEntry& Entry = OutResult.Entries[i];
+		Entry.CornerID = Baked.CornerID;
+		Entry.EdgeA = Baked.EdgeA;
+		Entry.EdgeB = Baked.EdgeB;
+		Entry.CurrentLineID = OutResult.WallEdges[Baked.EdgeA].LineID;
+		Entry.TargetLineID = OutResult.WallEdges[Baked.EdgeB].LineID;
+		Entry.Start = CellOrigin + FVector(Baked.Start);
+		Entry.End = CellOrigin + FVector(Baked.End);
+		Entry.Location = CellOrigin + FVector(Baked.Location);
+		Entry.Width = Baked.Width;
+	}
+
+	return true;
+}
+
+
+FNavAwareBakedDataWriter::FNavAwareBakedDataWriter(float InCellSize, float InRadius, uint32 InSettingsHash)
+{
+	Header.CellSize = InCellSize;
+	Header.Radius = InRadius;
+	Header.SettingsHash = InSettingsHash;
+}
+
+void FNavAwareBakedDataWriter::AddCell(const FIntVector& Key, const FVector& Origin, const FNavAwareResult& Result)
+{
+	FNavAwareBakedCell& Cell = Cells.AddDefaulted_GetRef();
+	Cell.Key = Key;
+	Cell.OriginInCell = FVector3f(Origin - FNavAwareBakedData::GetCellMin(Key, Header.CellSize));
+	Cell.FirstEdge = Edges.Num();
+	Cell.NumEdges = Result.WallEdges.Num();
+	Cell.FirstCorner = Corners.Num();
+	Cell.NumCorners = Result.Corners.Num();
+	Cell.FirstEntry = Entries.Num();
+	Cell.NumEntries = Result.Entries.Num();
+
+	for (const auto& Edge : Result.WallEdges)
+	{
+		FNavAwareBakedEdge& Baked = Edges.AddZeroed_GetRef();
+		Baked.Start = FVector3f(Edge.Start - Origin);
+		Baked.End = FVector3f(Edge.End - Origin);
+		Baked.PrevEdge = Edge.PrevEdge;
+		Baked.NextEdge = Edge.NextEdge;
+		Baked.LineID = Edge.LineID;
+		Baked.Type = static_cast<uint8>(Edge.Type);
+	}
+	
+	for (const auto& Corner : Result.Corners)
+	{
+		FNavAwareBakedCorner& Baked = Corners.AddZeroed_GetRef();
+		Baked.CornerStart = Corner.CornerStart;
+		Baked.CornerEnd = Corner.CornerEnd;
+		Baked.CornerID = Corner.CornerID;
+	}
+	
+	for (const auto& Entry : Result.Entries)
+	{
+		FNavAwareBakedEntry& Baked = Entries.AddZeroed_GetRef();
+		Baked.CornerID = Entry.CornerID;
+		Baked.EdgeA = Entry.EdgeA;
+		Baked.EdgeB = Entry.EdgeB;
+		Baked.Start = FVector3f(Entry.Start - Origin);
+		Baked.End = FVector3f(Entry.End - Origin);
+		Baked.Location = FVector3f(Entry.Location - Origin);
+		Baked.Width = Entry.Width;
+	}
+}
+
+bool FNavAwareBakedDataWriter::Save(const FString& Path)
+{
+	Cells.Sort([](const FNavAwareBakedCell& A, const FNavAwareBakedCell& B)
+	{
+		return CellKeyLess(A.Key, B.Key);
+	});
+	
+	Header.NumCells = Cells.Num();
+	Header.NumEdges = Edges.Num();
+	Header.NumCorners = Corners.Num();
+	Header.NumEntries = Entries.Num();
+
+	TArray<uint8> Bytes;
+	Bytes.Reserve(sizeof(FNavAwareBakeHeader) + Cells.Num() * sizeof(FNavAwareBakedCell) + Edges.Num() * sizeof(FNavAwareBakedEdge)
+		+ Corners.Num() * sizeof(FNavAwareBakedCorner) + Entries.Num() * sizeof(FNavAwareBakedEntry));
+	
+	Bytes.Append(reinterpret_cast<const uint8*>(&Header), sizeof(FNavAwareBakeHeader));
+	Bytes.Append(reinterpret_cast<const uint8*>(Cells.GetData()), Cells.Num() * sizeof(FNavAwareBakedCell));
+	Bytes.Append(reinterpret_cast<const uint8*>(Edges.GetData()), Edges.Num() * sizeof(FNavAwareBakedEdge));
+	Bytes.Append(reinterpret_cast<const uint8*>(Corners.GetData()), Corners.Num() * sizeof(FNavAwareBakedCorner));
+	Bytes.Append(reinterpret_cast<const uint8*>(Entries.GetData()), Entries.Num() * sizeof(FNavAwareBakedEntry));
+
+	return FFileHelper::SaveArrayToFile(Bytes, *Path);
+}
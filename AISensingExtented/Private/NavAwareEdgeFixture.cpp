@@ -0,0 +1,209 @@
+﻿#include "NavAwareEdgeFixture.h"
+
+#if WITH_EDITOR
+
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "Algo/Reverse.h"
+
+
+/*Edges from every point to the next one, closed loops also get the last one back to the first*/
+static void AddPolyline(TArray<FNavigationWallEdge>& OutEdges, const TArray<FVector>& Points, bool bClosed)
+{
+	const int32 NumSegments = bClosed ? Points.Num() : Points.Num() - 1;
+	for (int32 i = 0; i < NumSegments; i++)
+	{
+		FNavigationWallEdge& Edge = OutEdges.AddDefaulted_GetRef();
+		Edge.Start = Points[i];
+		Edge.End = Points[(i + 1) % Points.Num()];
+	}
+}
+
+/*FindEdges hands edges out in poly order rather than chained, shuffle so gathering does real work*/
+static void ShuffleEdges(TArray<FNavigationWallEdge>& InOutEdges, FRandomStream& Stream)
+{
+	for (int32 i = InOutEdges.Num() - 1; i > 0; i--)
+	{
+		InOutEdges.Swap(i, Stream.RandRange(0, i));
+	}
+}
+
+/*Straight polyline of NumSegments pieces from Start along Direction*/
+static void AddStraight(TArray<FVector>& OutPoints, const FVector& Start, const FVector& Direction, float Length, int32 NumSegments)
+{
+	for (int32 i = 0; i < NumSegments; i++)
+	{
+		OutPoints.Add(Start + Direction * (Length * i / NumSegments));
+	}
+}
+
+
+FString FNavAwareEdgeFixture::GetFixtureDir()
+{
+	return FPaths::ProjectSavedDir() / TEXT("NavAware") / TEXT("Fixtures");
+}
+
+bool FNavAwareEdgeFixture::Save(const FString& Path, const TArray<FNavigationWallEdge>& InEdges)
+{
+	FString Text;
+	for (const auto& Edge : InEdges)
+	{
+		Text += FString::Printf(TEXT("%f %f %f %f %f %f\n"), Edge.Start.X, Edge.Start.Y, Edge.Start.Z, Edge.End.X, Edge.End.Y, Edge.End.Z);
+	}
+	return FFileHelper::SaveStringToFile(Text, *Path);
+}
+
+bool FNavAwareEdgeFixture::Load(const FString& Path, FNavAwareEdgeFixture& OutFixture)
+{
+	TArray<FString> Lines;
+	if (!FFileHelper::LoadFileToStringArray(Lines, *Path)) return false;
+
+	OutFixture.Name = FPaths::GetBaseFilename(Path);
+	OutFixture.Edges.Reset(Lines.Num());
+	
+	TArray<FString> Values;
+	for (const FString& Line : Lines)
+	{
+		Line.ParseIntoArrayWS(Values);
+		if (Values.Num() != 6) continue;
+		
+		FNavigationWallEdge& Edge = OutFixture.Edges.AddDefaulted_GetRef();
+		Edge.Start = FVector(FCString::Atod(*Values[0]), FCString::Atod(*Values[1]), FCString::Atod(*Values[2]));
+		Edge.End = FVector(FCString::Atod(*Values[3]), FCString::Atod(*Values[4]), FCString::Atod(*Values[5]));
+	}
+	
+	return OutFixture.Edges.Num() > 0;
+}
+
+FNavAwareEdgeFixture FNavAwareEdgeFixture::MakeCorridor(int32 NumEdges, int32 Seed)
+{
+	FRandomStream Stream(Seed);
+	FNavAwareEdgeFixture Fixture;
+	Fixture.Name = TEXT("Corridor");
+
+	const int32 PerWall = FMath::Max(NumEdges / 2, 1);
+	const float Length = PerWall * 100.f;
+	
+	TArray<FVector> Points;
+	AddStraight(Points, FVector(0.f, -200.f, 0.f), FVector::ForwardVector, Length, PerWall);
+	Points.Add(FVector(Length, -200.f, 0.f));
+	AddPolyline(Fixture.Edges, Points, false);
+
+	Points.Reset();
+	AddStraight(Points, FVector(Length, 200.f, 0.f), FVector::BackwardVector, Length, PerWall);
+	Points.Add(FVector(0.f, 200.f, 0.f));
+	AddPolyline(Fixture.Edges, Points, false);
+
+	ShuffleEdges(Fixture.Edges, Stream);
+	return Fixture;
+}
+
+FNavAwareEdgeFixture FNavAwareEdgeFixture::MakeCrossRoads(int32 NumEdges, int32 Seed)
+{
+	FRandomStream Stream(Seed);
+	FNavAwareEdgeFixture Fixture;
+	Fixture.Name = TEXT("CrossRoads");
+
+	//every quarter is one wall coming in along an arm, turning at the crossing and leaving along the next arm
+	const int32 PerArm = FMath::Max(NumEdges / 8, 1);
+	const float HalfWidth = 200.f;
+	const float ArmLength = PerArm * 100.f;
+	
+	for (int32 Quarter = 0; Quarter < 4; Quarter++)
+	{
+		const FRotator Rotation(0.f, 90.f * Quarter, 0.f);
+		const FVector InArm = Rotation.RotateVector(FVector::BackwardVector);
+		const FVector OutArm = Rotation.RotateVector(FVector::LeftVector);
+		const FVector Corner = Rotation.RotateVector(FVector(HalfWidth, -HalfWidth, 0.f));
+
+		TArray<FVector> Points;
+		AddStraight(Points, Corner - InArm * ArmLength, InArm, ArmLength, PerArm);
+		AddStraight(Points, Corner, OutArm, ArmLength, PerArm);
+		Points.Add(Corner + OutArm * ArmLength);
+
+		//walked from the out arm back, so the crossing stays on the right
+		Algo::Reverse(Points);
+		AddPolyline(Fixture.Edges, Points, false);
+	}
+
+	ShuffleEdges(Fixture.Edges, Stream);
+	return Fixture;
+}
+
+FNavAwareEdgeFixture FNavAwareEdgeFixture::MakeRoomLoops(int32 NumEdges, int32 Seed)
+{
+	FRandomStream Stream(Seed);
+	FNavAwareEdgeFixture Fixture;
+	Fixture.Name = TEXT("RoomLoops");
+
+	//rooms of 4 sides with 4 pieces each, as many as fit in the edge count
+	const int32 PerSide = 4;
+	const int32 NumRooms = FMath::Max(NumEdges / (PerSide * 4), 1);
+	const float Size = 400.f;
+	
+	for (int32 Room = 0; Room < NumRooms; Room++)
+	{
+		const FVector Origin(Room % 8 * Size * 2.f, Room / 8 * Size * 2.f, 0.f);
+		
+		TArray<FVector> Points;
+		AddStraight(Points, Origin, FVector::ForwardVector, Size, PerSide);
+		AddStraight(Points, Origin + FVector(Size, 0.f, 0.f), FVector::RightVector, Size, PerSide);
+		AddStraight(Points, Origin + FVector(Size, Size, 0.f), FVector::BackwardVector, Size, PerSide);
+		AddStraight(Points, Origin + FVector(0.f, Size, 0.f), FVector::LeftVector, Size, PerSide);
+		AddPolyline(Fixture.Edges, Points, true);
+	}
+
+	ShuffleEdges(Fixture.Edges, Stream);
+	return Fixture;
+}
+
+FNavAwareEdgeFixture FNavAwareEdgeFixture::MakeNoisyCurve(int32 NumEdges, int32 Seed)
+{
+	FRandomStream Stream(Seed);
+	FNavAwareEdgeFixture Fixture;
+	Fixture.Name = TEXT("NoisyCurve");
+
+	const int32 PerWall = FMath::Max(NumEdges / 2, 1);
+	const float Angle = PI;
+	
+	for (const float Radius : { 1000.f, 1400.f })
+	{
+		TArray<FVector> Points;
+		for (int32 i = 0; i <= PerWall; i++)
+		{
+			//inner wall runs from PI down to 0 and the outer one back up, so the ring between them stays on the right
+			const float T = Radius > 1000.f ? static_cast<float>(i) / PerWall : 1.f - static_cast<float>(i) / PerWall;
+			const float Jitter = Stream.FRandRange(-15.f, 15.f);
+			Points.Add(FVector(FMath::Cos(T * Angle), FMath::Sin(T * Angle), 0.f) * (Radius + Jitter));
+		}
+		AddPolyline(Fixture.Edges, Points, false);
+	}
+
+	ShuffleEdges(Fixture.Edges, Stream);
+	return Fixture;
+}
+
+void FNavAwareEdgeFixture::MakeDistantMerge(int32 Seed, FNavAwareEdgeFixture& OutBefore, FNavAwareEdgeFixture& OutAfter)
+{
+	//far walls go first, lines are numbered by the order of their heads
+	TArray<FVector> Left, Right;
+	AddStraight(Left, FVector(5000.f, 0.f, 0.f), FVector::ForwardVector, 400.f, 4);
+	Left.Add(FVector(5400.f, 0.f, 0.f));
+	AddStraight(Right, FVector(5500.f, 0.f, 0.f), FVector::ForwardVector, 400.f, 4);
+	Right.Add(FVector(5900.f, 0.f, 0.f));
+
+	OutBefore = FNavAwareEdgeFixture();
+	OutBefore.Name = TEXT("DistantMerge");
+	AddPolyline(OutBefore.Edges, Left, false);
+	AddPolyline(OutBefore.Edges, Right, false);
+
+	OutAfter = OutBefore;
+	FNavigationWallEdge& Gap = OutAfter.Edges.AddDefaulted_GetRef();
+	Gap.Start = Left.Last();
+	Gap.End = Right[0];
+
+	const FNavAwareEdgeFixture CrossRoads = MakeCrossRoads(48, Seed);
+	OutBefore.Edges.Append(CrossRoads.Edges);
+	OutAfter.Edges.Append(CrossRoads.Edges);
+}
+#endif
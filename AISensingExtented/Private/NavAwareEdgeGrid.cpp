@@ -0,0 +1,100 @@
+﻿#include "NavAwareEdgeGrid.h"
+
+
+void FNavAwareEdgeGrid::Build(const FNavAwareEdgeStore& InEdges, float InCellSize)
+{
+	Edges = &InEdges;
+	CellSize = FMath::Max(InCellSize, 1.f);
+	
+	const int32 Num = InEdges.Num();
+	CellHeads.Reset();
+	CellItems.Reset();
+	EdgeBounds.SetNumUninitialized(Num);
+	EdgeMiddles.SetNumUninitialized(Num);
+	NumLines = 0;
+
+	for (int32 i = 0; i < Num; i++)
+	{
+		NumLines = FMath::Max(NumLines, InEdges.LineIDs[i] + 1);
+		
+		const FBox2f& Bounds = EdgeBounds[i] = InEdges.GetBounds2D(i);
+		EdgeMiddles[i] = InEdges.GetMiddle(i);
+
+		const FIntPoint MinCell = ToCell(Bounds.Min.X, Bounds.Min.Y);
+		const FIntPoint MaxCell = ToCell(Bounds.Max.X, Bounds.Max.Y);
+		for (int32 X = MinCell.X; X <= MaxCell.X; X++)
+		{
+			for (int32 Y = MinCell.Y; Y <= MaxCell.Y; Y++)
+			{
+				int32& Head = CellHeads.FindOrAdd(FIntPoint(X, Y), INDEX_NONE);
+				Head = CellItems.Add({ i, Head });
+			}
+		}
+	}
+
+	EdgeStamps.Init(0, Num);
+	LineStamps.Init(0, NumLines);
+	BestEdgeOfLine.SetNumUninitialized(NumLines);
+	BestDistOfLine.SetNumUninitialized(NumLines);
+	QueryStamp = 0;
+}
+
+void FNavAwareEdgeGrid::FindNearestEdgePerLine(int32 EdgeIndex, float MaxDistance, TArray<int32>& OutEdges) const
+{
+	OutEdges.Reset();
+	if (Edges == nullptr || EdgeIndex < 0 || EdgeIndex >= Edges->Num()) return;
+
+	QueryStamp++;
+	const int32 CurLineID = Edges->LineIDs[EdgeIndex];
+	const FVector3f& CurMiddle = EdgeMiddles[EdgeIndex];
+	const FBox2f QueryBounds = EdgeBounds[EdgeIndex].ExpandBy(MaxDistance);
+
+	const FIntPoint MinCell = ToCell(QueryBounds.Min.X, QueryBounds.Min.Y);
+	const FIntPoint MaxCell = ToCell(QueryBounds.Max.X, QueryBounds.Max.Y);
+	TArray<int32, TInlineAllocator<32>> FoundLines;
+	
+	for (int32 X = MinCell.X; X <= MaxCell.X; X++)
+	{
+		for (int32 Y = MinCell.Y; Y <= MaxCell.Y; Y++)
+		{
+			const int32* Head = CellHeads.Find(FIntPoint(X, Y));
+			for (int32 Item = Head ? *Head : INDEX_NONE; Item != INDEX_NONE; Item = CellItems[Item].Next)
+			{
+				const int32 Candidate = CellItems[Item].Edge;
+				
+				//edges spanning several cells are met more than once
+				if (EdgeStamps[Candidate] == QueryStamp) continue;
+				EdgeStamps[Candidate] = QueryStamp;
+				
+				const int32 LineID = Edges->LineIDs[Candidate];
+				if (LineID == CurLineID || !QueryBounds.Intersect(EdgeBounds[Candidate])) continue;
+
+				const float DistSquared = FVector3f::DistSquared(CurMiddle, EdgeMiddles[Candidate]);
+				if (LineStamps[LineID] != QueryStamp)
+				{
+					LineStamps[LineID] = QueryStamp;
+					BestEdgeOfLine[LineID] = Candidate;
+					BestDistOfLine[LineID] = DistSquared;
+					FoundLines.Add(LineID);
+				}
+				else if (DistSquared < BestDistOfLine[LineID])
+				{
+					BestEdgeOfLine[LineID] = Candidate;
+					BestDistOfLine[LineID] = DistSquared;
+				}
+			}
+		}
+	}
+
+	//only one edge per line is left, sorting those is cheap
+	FoundLines.Sort([this](const int32 A, const int32 B)
+	{
+		return BestDistOfLine[A] < BestDistOfLine[B];
+	});
+	
+	OutEdges.Reserve(FoundLines.Num());
+	for (const int32 LineID : FoundLines)
+	{
+		OutEdges.Add(BestEdgeOfLine[LineID]);
+	}
+}
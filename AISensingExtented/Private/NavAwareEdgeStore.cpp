@@ -0,0 +1,14 @@
+﻿#include "NavAwareEdgeStore.h"
+
+
+void FNavAwareEdgeStore::ToView(TArray<FNavPoint>& OutEdges) const
+{
+	const int32 NumEdges = Num();
+	OutEdges.Reset(NumEdges);
+	
+	for (int32 i = 0; i < NumEdges; i++)
+	{
+		OutEdges.Add(FNavPoint(GetStart(i), GetEnd(i), i, LineIDs[i], Types[i], 0.f, PrevEdges[i], NextEdges[i]));
+	}
+	ANavAwareEnhancedBase::FillEdgeDegrees(OutEdges);
+}
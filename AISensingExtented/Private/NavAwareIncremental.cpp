@@ -0,0 +1,129 @@
+﻿#include "NavAwareIncremental.h"
+
+
+/*First edge & number of edges of every line, indexed by LineID*/
+static void GatherLineRanges(const FNavAwareEdgeStore& Edges, TArray<int32>& OutFirst, TArray<int32>& OutNum)
+{
+	int32 NumLines = 0;
+	for (const int32 LineID : Edges.LineIDs)
+	{
+		NumLines = FMath::Max(NumLines, LineID + 1);
+	}
+	
+	OutFirst.Init(INDEX_NONE, NumLines);
+	OutNum.Init(0, NumLines);
+	for (int32 i = 0; i < Edges.Num(); i++)
+	{
+		const int32 LineID = Edges.LineIDs[i];
+		if (OutFirst[LineID] == INDEX_NONE) OutFirst[LineID] = i;
+		OutNum[LineID]++;
+	}
+}
+
+
+void FNavAwareEdgeDiff::Build(const FNavAwareEdgeStore& OldEdges, const FNavAwareEdgeStore& NewEdges, float Quantum)
+{
+	const int32 NumOld = OldEdges.Num();
+	const int32 NumNew = NewEdges.Num();
+	NewToOld.Init(INDEX_NONE, NumNew);
+	OldToNew.Init(INDEX_NONE, NumOld);
+	ChangedBounds.Reset();
+
+	//both stores are relative to their own query origin, keys are made in world space
+	Quantum = FMath::Max(Quantum, UE_KINDA_SMALL_NUMBER);
+	const auto ToKey = [Quantum](const FNavAwareEdgeStore& Edges, int32 Edge)
+	{
+		const FVector Start = Edges.GetStart(Edge);
+		const FVector End = Edges.GetEnd(Edge);
+		return TPair<FIntVector, FIntVector>(
+			FIntVector(FMath::RoundToInt(Start.X / Quantum), FMath::RoundToInt(Start.Y / Quantum), FMath::RoundToInt(Start.Z / Quantum)),
+			FIntVector(FMath::RoundToInt(End.X / Quantum), FMath::RoundToInt(End.Y / Quantum), FMath::RoundToInt(End.Z / Quantum)));
+	};
+
+	TMap<TPair<FIntVector, FIntVector>, int32> OldByKey;
+	OldByKey.Reserve(NumOld);
+	for (int32 i = 0; i < NumOld; i++)
+	{
+		OldByKey.Add(ToKey(OldEdges, i), i);
+	}
+
+	TArray<int32> OldLineFirst, OldLineNum, NewLineFirst, NewLineNum;
+	GatherLineRanges(OldEdges, OldLineFirst, OldLineNum);
+	GatherLineRanges(NewEdges, NewLineFirst, NewLineNum);
+	DirtyLines.Init(false, NewLineFirst.Num());
+	NewLineToOld.Init(INDEX_NONE, NewLineFirst.Num());
+
+	for (int32 LineID = 0; LineID < NewLineFirst.Num(); LineID++)
+	{
+		const int32 First = NewLineFirst[LineID];
+		if (First == INDEX_NONE) continue;
+		const int32 Num = NewLineNum[LineID];
+
+		//single edges only need to match one by one
+		if (LineID == 0)
+		{
+			NewLineToOld[0] = 0;
+			for (int32 i = First; i < First + Num; i++)
+			{
+				const int32* Old = OldByKey.Find(ToKey(NewEdges, i));
+				if (Old && OldEdges.LineIDs[*Old] == 0 && OldToNew[*Old] == INDEX_NONE)
+				{
+					NewToOld[i] = *Old;
+					OldToNew[*Old] = i;
+				}
+			}
+			continue;
+		}
+
+		//the head decides the whole line, MarkCorner walks it from there
+		const int32* OldHead = OldByKey.Find(ToKey(NewEdges, First));
+		bool bUnchanged = OldHead != nullptr;
+		int32 OldLineID = 0;
+		if (bUnchanged)
+		{
+			OldLineID = OldEdges.LineIDs[*OldHead];
+			bUnchanged = OldLineID != 0 && OldLineFirst[OldLineID] == *OldHead && OldLineNum[OldLineID] == Num
+				&& OldEdges.HasPrev(*OldHead) == NewEdges.HasPrev(First);
+		}
+		for (int32 Offset = 1; bUnchanged && Offset < Num; Offset++)
+		{
+			const int32* Old = OldByKey.Find(ToKey(NewEdges, First + Offset));
+			bUnchanged = Old && *Old == *OldHead + Offset;
+		}
+		
+		if (bUnchanged)
+		{
+			NewLineToOld[LineID] = OldLineID;
+			for (int32 Offset = 0; Offset < Num; Offset++)
+			{
+				NewToOld[First + Offset] = *OldHead + Offset;
+				OldToNew[*OldHead + Offset] = First + Offset;
+			}
+		}
+		else
+		{
+			DirtyLines[LineID] = true;
+		}
+	}
+
+	//whatever is left unmatched on either side was added or removed, old bounds are moved into the new edges' space
+	const FVector2f OldToNewOffset(FVector2D(OldEdges.Origin - NewEdges.Origin));
+	for (int32 i = 0; i < NumNew; i++)
+	{
+		if (NewToOld[i] == INDEX_NONE) ChangedBounds.Add(NewEdges.GetBounds2D(i));
+	}
+	for (int32 i = 0; i < NumOld; i++)
+	{
+		if (OldToNew[i] == INDEX_NONE) ChangedBounds.Add(OldEdges.GetBounds2D(i).ShiftBy(OldToNewOffset));
+	}
+}
+
+bool FNavAwareEdgeDiff::IsNearChange(const FBox2f& Bounds, float Distance) const
+{
+	const FBox2f Expanded = Bounds.ExpandBy(Distance);
+	for (const FBox2f& Changed : ChangedBounds)
+	{
+		if (Expanded.Intersect(Changed)) return true;
+	}
+	return false;
+}
@@ -0,0 +1,24 @@
+﻿#include "NavAwareStats.h"
+
+DEFINE_STAT(STAT_NavAware_Pipeline);
+DEFINE_STAT(STAT_NavAware_FindEdges);
+DEFINE_STAT(STAT_NavAware_GatherEdgesWithSorting);
+DEFINE_STAT(STAT_NavAware_EdgeLinker);
+DEFINE_STAT(STAT_NavAware_EdgeDiff);
+DEFINE_STAT(STAT_NavAware_MarkCorner);
+DEFINE_STAT(STAT_NavAware_FilterOnlyInnerEdge);
+DEFINE_STAT(STAT_NavAware_MarkEntryEdges);
+DEFINE_STAT(STAT_NavAware_MakeCornerArray);
+DEFINE_STAT(STAT_NavAware_TakeSteps);
+
+DEFINE_STAT(STAT_NavAware_Queries);
+DEFINE_STAT(STAT_NavAware_Edges);
+DEFINE_STAT(STAT_NavAware_Lines);
+DEFINE_STAT(STAT_NavAware_Corners);
+DEFINE_STAT(STAT_NavAware_Entries);
+DEFINE_STAT(STAT_NavAware_FindNearestPolyCalls);
+
+DEFINE_STAT(STAT_NavAware_QueryEdges);
+DEFINE_STAT(STAT_NavAware_QueryLines);
+DEFINE_STAT(STAT_NavAware_QueryCorners);
+DEFINE_STAT(STAT_NavAware_QueryEntries);
@@ -0,0 +1,63 @@
+﻿#include "NavAwareTrace.h"
+
+#if NAVAWARE_WITH_TRACE
+
+#include "Actor/NavAwareEnhancedBase.h"
+
+static thread_local FNavAwareTraceBuffer* GCurrentTraceBuffer = nullptr;
+
+FNavAwareTraceBuffer* FNavAwareTraceBuffer::GetCurrent()
+{
+	return GCurrentTraceBuffer;
+}
+
+FString FNavAwareTraceBuffer::Format(const FNavAwareTraceRecord& Record)
+{
+	switch (Record.Event)
+	{
+	case ENavAwareTraceEvent::EdgesSorted:
+		return FString::Printf(TEXT("Finished sorting, InArray count: %d, OutEdges count: %d"), Record.A, Record.B);
+	case ENavAwareTraceEvent::CornersMarked:
+		return Record.B == INDEX_NONE
+			? FString::Printf(TEXT("Finished corner marking of %d edges"), Record.A)
+			: FString::Printf(TEXT("Finished corner marking of %d edges, %d dirty lines"), Record.A, Record.B);
+	case ENavAwareTraceEvent::EntryEdgesMarked:
+		return FString::Printf(TEXT("Finished marking entries of the corner, %d edges"), Record.A);
+	case ENavAwareTraceEvent::StepsStarted:
+		return FString::Printf(TEXT("Starting to steps for %d corners and find entries from them"), Record.A);
+	case ENavAwareTraceEvent::CornerReused:
+		return FString::Printf(TEXT("Corner[%d]: entries reused from the last query"), Record.A);
+	case ENavAwareTraceEvent::StepTarget:
+		return FString::Printf(TEXT("CurEdge: [%02d], TargetEdge: [%02d], Degree: %.1f"), Record.A, Record.B, Record.Value);
+	case ENavAwareTraceEvent::StepsFinished:
+		return FString::Printf(TEXT("Stepping finished, %d entries"), Record.A);
+	default:
+		return FString::Printf(TEXT("Unknown event %d"), static_cast<int32>(Record.Event));
+	}
+}
+
+void FNavAwareTraceBuffer::Dump(const FString& Owner) const
+{
+	UE_LOG(NavAware, Display, TEXT("%s: %d trace records, %u dropped"), *Owner, Records.Num(), GetNumDropped())
+	
+	//once wrapped, the oldest record sits right after the newest
+	const int32 First = Records.Num() < Capacity ? 0 : static_cast<int32>(NumRecorded & (Capacity - 1));
+	for (int32 i = 0; i < Records.Num(); i++)
+	{
+		UE_LOG(NavAware, Display, TEXT("  %s"), *Format(Records[(First + i) & (Capacity - 1)]))
+	}
+}
+
+FNavAwareTraceScope::FNavAwareTraceScope(FNavAwareTraceBuffer& Buffer)
+	: Previous(GCurrentTraceBuffer)
+{
+	Buffer.Reset();
+	GCurrentTraceBuffer = &Buffer;
+}
+
+FNavAwareTraceScope::~FNavAwareTraceScope()
+{
+	GCurrentTraceBuffer = Previous;
+}
+
+#endif
@@ -0,0 +1,16 @@
+﻿#include "Perception/AISenseConfig_NavAwareness.h"
+
+UAISenseConfig_NavAwareness::UAISenseConfig_NavAwareness(const FObjectInitializer& ObjectInitializer)
+	: Super(ObjectInitializer)
+{
+	DebugColor = FColor::Purple;
+	Implementation = UAISense_NavAwareness::StaticClass();
+
+	//a reporter refreshes its points every query, what it stops reporting fades out after this
+	MaxAge = 2.f;
+}
+
+TSubclassOf<UAISense> UAISenseConfig_NavAwareness::GetSenseImplementation() const
+{
+	return *Implementation;
+}
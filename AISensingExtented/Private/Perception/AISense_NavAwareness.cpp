@@ -0,0 +1,167 @@
+﻿#include "Perception/AISense_NavAwareness.h"
+
+#include "Perception/AISenseConfig_NavAwareness.h"
+#include "Perception/AIPerceptionSystem.h"
+#include "Perception/AIPerceptionComponent.h"
+#include "Perception/AISenseEvent.h"
+#include "Actor/NavAwareEnhancedBase.h"
+
+namespace
+{
+	const FAINavAwarenessPoint* FindNearestPoint(TConstArrayView<FAINavAwarenessPoint> Points, const FVector& Location, float RadiusSq, bool bEntries)
+	{
+		const FAINavAwarenessPoint* Nearest = nullptr;
+		double NearestDistSq = RadiusSq;
+		for (const FAINavAwarenessPoint& Point : Points)
+		{
+			if (Point.bIsEntry != bEntries) continue;
+			
+			const double DistSq = FVector::DistSquared(Point.Location, Location);
+			if (DistSq <= NearestDistSq)
+			{
+				Nearest = &Point;
+				NearestDistSq = DistSq;
+			}
+		}
+		return Nearest;
+	}
+}
+
+const FName UAISense_NavAwareness::EntryTag = FName(TEXT("NavAwareEntry"));
+const FName UAISense_NavAwareness::CornerTag = FName(TEXT("NavAwareCorner"));
+int32 UAISense_NavAwareness::NumListeners = 0;
+
+UAISense_NavAwareness::FDigestedNavAwarenessProperties::FDigestedNavAwarenessProperties(const UAISenseConfig_NavAwareness& SenseConfig)
+	: RadiusSq(FMath::Square(SenseConfig.Radius)), bDetectEntries(SenseConfig.bDetectEntries), bDetectCorners(SenseConfig.bDetectCorners)
+{
+}
+
+UAISense_NavAwareness::UAISense_NavAwareness(const FObjectInitializer& ObjectInitializer)
+	: Super(ObjectInitializer)
+{
+	if (!HasAnyFlags(RF_ClassDefaultObject))
+	{
+		OnNewListenerDelegate.BindUObject(this, &UAISense_NavAwareness::OnNewListenerImpl);
+		OnListenerUpdateDelegate.BindUObject(this, &UAISense_NavAwareness::OnListenerUpdateImpl);
+		OnListenerRemovedDelegate.BindUObject(this, &UAISense_NavAwareness::OnListenerRemovedImpl);
+	}
+}
+
+void UAISense_NavAwareness::RegisterEvent(const FAINavAwarenessEvent& Event)
+{
+	if (Event.Instigator == nullptr) return;
+	
+	//only the newest result of a reporter matters, an older one still queued is dropped
+	const int32 Existing = RegisteredEvents.IndexOfByPredicate([&Event](const FAINavAwarenessEvent& Queued)
+	{
+		return Queued.Instigator == Event.Instigator;
+	});
+	if (Existing != INDEX_NONE)
+	{
+		RegisteredEvents[Existing] = Event;
+	}
+	else
+	{
+		RegisteredEvents.Add(Event);
+	}
+	
+	RequestImmediateUpdate();
+}
+
+void UAISense_NavAwareness::RegisterWrappedEvent(UAISenseEvent& PerceptionEvent)
+{
+	UE_LOG(NavAware, Warning, TEXT("UAISense_NavAwareness takes no wrapped events, report through ReportNavAwarenessEvent"))
+}
+
+void UAISense_NavAwareness::ReportNavAwarenessEvent(UObject* WorldContextObject, const FAINavAwarenessEvent& Event)
+{
+	if (UAIPerceptionSystem* PerceptionSystem = UAIPerceptionSystem::GetCurrent(WorldContextObject))
+	{
+		PerceptionSystem->OnEvent(Event);
+	}
+}
+
+float UAISense_NavAwareness::Update()
+{
+	AIPerception::FListenerMap& ListenersMap = *GetListeners();
+
+	for (AIPerception::FListenerMap::TIterator ListenerIt(ListenersMap); ListenerIt; ++ListenerIt)
+	{
+		FPerceptionListener& Listener = ListenerIt->Value;
+		if (!Listener.HasSense(GetSenseID())) continue;
+
+		const FDigestedNavAwarenessProperties* PropDigest = DigestedProperties.Find(Listener.GetListenerID());
+		if (PropDigest == nullptr) continue;
+		
+		for (const FAINavAwarenessEvent& Event : RegisteredEvents)
+		{
+			if (Event.Instigator == nullptr) continue;
+			
+			//entries are what an agent reacts to, a corner only counts when no entry is in reach
+			const FAINavAwarenessPoint* Nearest = nullptr;
+			if (PropDigest->bDetectEntries)
+			{
+				Nearest = FindNearestPoint(Event.Points, Listener.CachedLocation, PropDigest->RadiusSq, true);
+			}
+			if (Nearest == nullptr && PropDigest->bDetectCorners)
+			{
+				Nearest = FindNearestPoint(Event.Points, Listener.CachedLocation, PropDigest->RadiusSq, false);
+			}
+			
+			if (Nearest)
+			{
+				Listener.RegisterStimulus(Event.Instigator, FAIStimulus(*this, 1.f, Nearest->Location, Listener.CachedLocation,
+					FAIStimulus::SensingSucceeded, Nearest->bIsEntry ? EntryTag : CornerTag));
+			}
+		}
+	}
+
+	RegisteredEvents.Reset();
+
+	//woken up by the next report
+	return SuspendNextUpdate;
+}
+
+void UAISense_NavAwareness::OnNewListenerImpl(const FPerceptionListener& NewListener)
+{
+	const UAIPerceptionComponent* ListenerPtr = NewListener.Listener.Get();
+	check(ListenerPtr);
+	const UAISenseConfig_NavAwareness* SenseConfig = Cast<const UAISenseConfig_NavAwareness>(ListenerPtr->GetSenseConfig(GetSenseID()));
+	check(SenseConfig);
+	
+	const int32 NumBefore = DigestedProperties.Num();
+	DigestedProperties.Add(NewListener.GetListenerID(), FDigestedNavAwarenessProperties(*SenseConfig));
+	NumListeners += DigestedProperties.Num() - NumBefore;
+}
+
+void UAISense_NavAwareness::OnListenerUpdateImpl(const FPerceptionListener& UpdatedListener)
+{
+	const FPerceptionListenerID ListenerID = UpdatedListener.GetListenerID();
+	const int32 NumBefore = DigestedProperties.Num();
+
+	if (UpdatedListener.HasSense(GetSenseID()))
+	{
+		const UAISenseConfig_NavAwareness* SenseConfig = Cast<const UAISenseConfig_NavAwareness>(UpdatedListener.Listener->GetSenseConfig(GetSenseID()));
+		check(SenseConfig);
+		DigestedProperties.FindOrAdd(ListenerID) = FDigestedNavAwarenessProperties(*SenseConfig);
+	}
+	else
+	{
+		DigestedProperties.Remove(ListenerID);
+	}
+	NumListeners += DigestedProperties.Num() - NumBefore;
+}
+
+void UAISense_NavAwareness::OnListenerRemovedImpl(const FPerceptionListener& RemovedListener)
+{
+	NumListeners -= DigestedProperties.Remove(RemovedListener.GetListenerID());
+}
+
+void UAISense_NavAwareness::BeginDestroy()
+{
+	//the perception system goes away with its world, listeners still digested are never removed one by one
+	NumListeners -= DigestedProperties.Num();
+	DigestedProperties.Empty();
+	
+	Super::BeginDestroy();
+}
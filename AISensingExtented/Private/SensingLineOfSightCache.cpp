@@ -0,0 +1,46 @@
+﻿#include "SensingLineOfSightCache.h"
+
+
+void FSensingLineOfSightCache::Configure(float InCellSize, float InTimeToLive)
+{
+	CellSize = FMath::Max(InCellSize, 1.f);
+	TimeToLive = FMath::Max(InTimeToLive, 0.f);
+	Entries.Reset();
+}
+
+FSensingLineOfSightKey FSensingLineOfSightCache::MakeKey(const FVector& ObserverLocation, const FVector& TargetLocation, uint8 Mode) const
+{
+	FSensingLineOfSightKey Key;
+	Key.ObserverCell = ToCell(ObserverLocation);
+	Key.TargetCell = ToCell(TargetLocation);
+	Key.Mode = Mode;
+	return Key;
+}
+
+bool FSensingLineOfSightCache::Find(const FSensingLineOfSightKey& Key, double Now, bool& bOutHasLineOfSight) const
+{
+	const FEntry* Entry = Entries.Find(Key);
+	if (Entry == nullptr || Now - Entry->Time > TimeToLive)
+	{
+		return false;
+	}
+	
+	bOutHasLineOfSight = Entry->bHasLineOfSight;
+	return true;
+}
+
+void FSensingLineOfSightCache::Store(const FSensingLineOfSightKey& Key, double Now, bool bHasLineOfSight)
+{
+	Entries.Add(Key, { Now, bHasLineOfSight });
+}
+
+void FSensingLineOfSightCache::Purge(double Now)
+{
+	for (auto It = Entries.CreateIterator(); It; ++It)
+	{
+		if (Now - It.Value().Time > TimeToLive)
+		{
+			It.RemoveCurrent();
+		}
+	}
+}
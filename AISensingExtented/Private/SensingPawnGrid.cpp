@@ -0,0 +1,88 @@
+﻿#include "SensingPawnGrid.h"
+
+#include "EngineUtils.h"
+#include "GameFramework/Pawn.h"
+#include "Components/PawnNoiseEmitterComponent.h"
+
+
+void FSensingPawnGrid::Build(UWorld* World, float InCellSize)
+{
+	CellSize = FMath::Max(InCellSize, 1.f);
+	
+	CellHeads.Reset();
+	CellItems.Reset();
+	Pawns.Reset();
+	NoiseMakers.Reset();
+	if (World == nullptr) return;
+
+	for (TActorIterator<APawn> It(World); It; ++It)
+	{
+		APawn* Pawn = *It;
+		if (!IsValid(Pawn)) continue;
+
+		const FVector Location = Pawn->GetActorLocation();
+		const int32 Index = Pawns.Add(Pawn);
+		
+		int32& Head = CellHeads.FindOrAdd(ToCell(Location.X, Location.Y), INDEX_NONE);
+		Head = CellItems.Add({ Index, Head });
+
+		if (Pawn->GetPawnNoiseEmitterComponent())
+		{
+			NoiseMakers.Add(Index);
+		}
+	}
+}
+
+void FSensingPawnGrid::AddRecentNoiseMakers(double SinceTime, TArray<APawn*>& OutPawns) const
+{
+	for (const int32 Index : NoiseMakers)
+	{
+		APawn* Pawn = Pawns[Index].Get();
+		const UPawnNoiseEmitterComponent* NoiseEmitter = Pawn ? Pawn->GetPawnNoiseEmitterComponent() : nullptr;
+		if (NoiseEmitter == nullptr) continue;
+
+		const bool bRemoteNoise = NoiseEmitter->GetLastNoiseTime(false) > SinceTime;
+		const bool bLoudLocalNoise = NoiseEmitter->GetLastNoiseTime(true) > SinceTime && NoiseEmitter->GetLastNoiseVolume(true) > 1.f;
+		if (bRemoteNoise || bLoudLocalNoise)
+		{
+			OutPawns.AddUnique(Pawn);
+		}
+	}
+}
+
+void FSensingPawnGrid::FindPawnsInCells(const FVector& Center, float Radius, TArray<APawn*>& OutPawns) const
+{
+	OutPawns.Reset();
+	
+	const FIntPoint MinCell = ToCell(Center.X - Radius, Center.Y - Radius);
+	const FIntPoint MaxCell = ToCell(Center.X + Radius, Center.Y + Radius);
+	
+	//a sensor seeing further than the world is wide shouldn't walk more cells than there are
+	if (static_cast<int64>(MaxCell.X - MinCell.X + 1) * (MaxCell.Y - MinCell.Y + 1) > CellHeads.Num())
+	{
+		for (const TWeakObjectPtr<APawn>& Pawn : Pawns)
+		{
+			if (APawn* Resolved = Pawn.Get())
+			{
+				OutPawns.Add(Resolved);
+			}
+		}
+		return;
+	}
+
+	for (int32 X = MinCell.X; X <= MaxCell.X; X++)
+	{
+		for (int32 Y = MinCell.Y; Y <= MaxCell.Y; Y++)
+		{
+			const int32* Head = CellHeads.Find(FIntPoint(X, Y));
+			for (int32 Item = Head ? *Head : INDEX_NONE; Item != INDEX_NONE; Item = CellItems[Item].Next)
+			{
+				//destroyed since the build
+				if (APawn* Pawn = Pawns[CellItems[Item].Pawn].Get())
+				{
+					OutPawns.Add(Pawn);
+				}
+			}
+		}
+	}
+}
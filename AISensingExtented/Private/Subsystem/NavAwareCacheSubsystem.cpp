@@ -0,0 +1,261 @@
+﻿#include "Subsystem/NavAwareCacheSubsystem.h"
+
+#include "NavigationSystem.h"
+#include "NavMesh/RecastNavMesh.h"
+#include "NavAwareStats.h"
+
+
+void UNavAwareCacheSubsystem::OnWorldBeginPlay(UWorld& InWorld)
+{
+	Super::OnWorldBeginPlay(InWorld);
+
+	if (UNavigationSystemV1* NavSystem = FNavigationSystem::GetCurrent<UNavigationSystemV1>(&InWorld))
+	{
+		NavSystem->OnNavigationGenerationFinishedDelegate.AddUniqueDynamic(this, &UNavAwareCacheSubsystem::OnNavigationGenerationFinished);
+	}
+	NavigationDirtyHandle = UNavigationSystemV1::NavigationDirtyEvent.AddUObject(this, &UNavAwareCacheSubsystem::OnNavigationDirtied);
+
+	const FString BakedDataPath = FNavAwareBakedData::GetBakedDataPath(&InWorld);
+	if (BakedData.Load(BakedDataPath))
+	{
+		UE_LOG(NavAware, Log, TEXT("Mapped baked awareness data %s, %u cells"), *BakedDataPath, BakedData.GetHeader()->NumCells)
+	}
+}
+
+void UNavAwareCacheSubsystem::Deinitialize()
+{
+	UNavigationSystemV1::NavigationDirtyEvent.Remove(NavigationDirtyHandle);
+	if (UNavigationSystemV1* NavSystem = FNavigationSystem::GetCurrent<UNavigationSystemV1>(GetWorld()))
+	{
+		NavSystem->OnNavigationGenerationFinishedDelegate.RemoveDynamic(this, &UNavAwareCacheSubsystem::OnNavigationGenerationFinished);
+	}
+	if (NumNavBuildLocks > 0)
+	{
+		NumNavBuildLocks = 1;
+		ReleaseNavBuildLock();
+	}
+	Flush();
+	BakedData.Unload();
+	BakedDirtyBounds.Empty();
+	
+	Super::Deinitialize();
+}
+
+bool UNavAwareCacheSubsystem::MakeKey(const ARecastNavMesh* NavMesh, const FVector& Origin, float Radius, uint32 SettingsHash, FNavAwareCacheKey& OutKey) const
+{
+	if (NavMesh == nullptr) return false;
+
+	const NavNodeRef Poly = NavMesh->FindNearestPoly(Origin, FVector(500.f, 500.f, 500.f));
+	INC_DWORD_STAT(STAT_NavAware_FindNearestPolyCalls);
+	uint32 TileIndex = 0;
+	if (Poly == INVALID_NAVNODEREF || !NavMesh->GetPolyTileIndex(Poly, TileIndex))
+	{
+		return false;
+	}
+
+	OutKey.Poly = Poly;
+	OutKey.TileIndex = static_cast<int32>(TileIndex);
+	OutKey.Cell = FIntVector(
+		FMath::FloorToInt(Origin.X / CellSize),
+		FMath::FloorToInt(Origin.Y / CellSize),
+		FMath::FloorToInt(Origin.Z / CellSize));
+	OutKey.Radius = FMath::RoundToInt(Radius);
+	OutKey.SettingsHash = SettingsHash;
+	
+	return true;
+}
+
+bool UNavAwareCacheSubsystem::FindResult(const FNavAwareCacheKey& Key, FNavAwareResult& OutResult)
+{
+	FNavAwareCacheEntry* Entry = CachedResults.Find(Key);
+	if (Entry == nullptr) return false;
+
+	LruList.RemoveNode(Entry->LruNode, false);
+	LruList.AddHead(Entry->LruNode);
+	OutResult = Entry->Result;
+	
+	return true;
+}
+
+void UNavAwareCacheSubsystem::StoreResult(const FNavAwareCacheKey& Key, const FNavAwareResult& Result, const ARecastNavMesh* NavMesh, const FVector& Origin, float Radius)
+{
+	if (NavMesh == nullptr || MaxCachedResults <= 0) return;
+	
+	RemoveEntry(Key);
+	if (CachedResults.Num() >= MaxCachedResults)
+	{
+		EvictLeastRecentlyUsed();
+	}
+
+	FNavAwareCacheEntry& Entry = CachedResults.Add(Key);
+	Entry.Result = Result;
+	LruList.AddHead(Key);
+	Entry.LruNode = LruList.GetHead();
+	GatherQueryTiles(NavMesh, Origin, Radius, Key.TileIndex, Entry.Tiles);
+
+	for (const int32 Tile : Entry.Tiles)
+	{
+		KeysByTile.Add(Tile, Key);
+	}
+}
+
+bool UNavAwareCacheSubsystem::FindBakedResult(const FVector& Origin, float Radius, uint32 SettingsHash, FNavAwareResult& OutResult) const
+{
+	const FNavAwareBakeHeader* Header = BakedData.GetHeader();
+	if (Header == nullptr || Header->SettingsHash != SettingsHash || FMath::RoundToInt(Header->Radius) != FMath::RoundToInt(Radius))
+	{
+		return false;
+	}
+
+	if (BakedDirtyBounds.Num() > 0)
+	{
+		const FIntVector Cell = FNavAwareBakedData::GetCellKey(Origin, Header->CellSize);
+		const FBox CellBounds = FBox(FNavAwareBakedData::GetCellMin(Cell, Header->CellSize), FNavAwareBakedData::GetCellMin(Cell + FIntVector(1), Header->CellSize)).ExpandBy(Radius);
+		for (const FBox& DirtyBounds : BakedDirtyBounds)
+		{
+			if (CellBounds.Intersect(DirtyBounds)) return false;
+		}
+	}
+
+	return BakedData.FindResult(Origin, BakedOriginToleranceScale * Header->CellSize, OutResult);
+}
+
+uint32 UNavAwareCacheSubsystem::GetAreaSerial(const ARecastNavMesh* NavMesh, const FVector& Origin, float Radius, int32 StartTile) const
+{
+	uint32 Serial = FlushSerial;
+	if (NavMesh == nullptr || TileSerials.Num() == 0) return Serial;
+
+	TArray<int32> Tiles;
+	GatherQueryTiles(NavMesh, Origin, Radius, StartTile, Tiles);
+	for (const int32 Tile : Tiles)
+	{
+		if (const uint32* TileSerial = TileSerials.Find(Tile))
+		{
+			Serial += *TileSerial;
+		}
+	}
+	
+	return Serial;
+}
+
+void UNavAwareCacheSubsystem::InvalidateTiles(const TArray<int32>& Tiles)
+{
+	if (Tiles.Num() == 0) return;
+	
+	TArray<FNavAwareCacheKey> Keys;
+	for (const int32 Tile : Tiles)
+	{
+		KeysByTile.MultiFind(Tile, Keys);
+		++TileSerials.FindOrAdd(Tile);
+	}
+	for (const auto& Key : Keys)
+	{
+		RemoveEntry(Key);
+	}
+	++InvalidationSerial;
+}
+
+bool UNavAwareCacheSubsystem::AcquireNavBuildLock()
+{
+	if (NumNavBuildLocks > 0)
+	{
+		++NumNavBuildLocks;
+		return true;
+	}
+	
+	//the flag isn't counted, a Custom lock of someone else could be removed under the worker, and ours must not remove theirs
+	UNavigationSystemV1* NavSystem = FNavigationSystem::GetCurrent<UNavigationSystemV1>(GetWorld());
+	if (NavSystem == nullptr || NavSystem->IsNavigationBuildingLocked(ENavigationBuildLock::Custom)) return false;
+	
+	NavSystem->AddNavigationBuildLock(ENavigationBuildLock::Custom);
+	NumNavBuildLocks = 1;
+	return true;
+}
+
+void UNavAwareCacheSubsystem::ReleaseNavBuildLock()
+{
+	if (NumNavBuildLocks <= 0 || --NumNavBuildLocks > 0) return;
+	
+	//dirty areas queued meanwhile are rebuilt on the next navigation tick, no full rebuild wanted here
+	if (UNavigationSystemV1* NavSystem = FNavigationSystem::GetCurrent<UNavigationSystemV1>(GetWorld()))
+	{
+		NavSystem->RemoveNavigationBuildLock(ENavigationBuildLock::Custom, UNavigationSystemV1::ELockRemovalRebuildAction::NoRebuild);
+	}
+}
+
+void UNavAwareCacheSubsystem::Flush()
+{
+	CachedResults.Empty();
+	KeysByTile.Empty();
+	LruList.Empty();
+	++InvalidationSerial;
+	++FlushSerial;
+}
+
+void UNavAwareCacheSubsystem::OnNavigationGenerationFinished(ANavigationData* NavData)
+{
+	//nothing was dirtied before, so it was a full rebuild, tile indices may not even mean the same anymore
+	if (PendingDirtyTiles.Num() == 0)
+	{
+		Flush();
+		return;
+	}
+
+	//tiles may have been queried again while they were being rebuilt
+	InvalidateTiles(PendingDirtyTiles.Array());
+	PendingDirtyTiles.Reset();
+}
+
+void UNavAwareCacheSubsystem::OnNavigationDirtied(const FBox& DirtyBounds)
+{
+	//the event is static and carries no world, e.g. PIE and the editor world share it.
+	//An area of another world isn't queued in this world's navigation system, this navmesh won't be rebuilt for it
+	const UNavigationSystemV1* NavSystem = FNavigationSystem::GetCurrent<UNavigationSystemV1>(GetWorld());
+	if (NavSystem == nullptr || !NavSystem->HasDirtyAreasQueued()) return;
+	
+	if (BakedData.IsLoaded())
+	{
+		BakedDirtyBounds.Add(DirtyBounds);
+	}
+	
+	const ARecastNavMesh* NavMesh = Cast<ARecastNavMesh>(NavSystem->GetDefaultNavDataInstance());
+	if (NavMesh == nullptr) return;
+
+	TArray<int32> Tiles;
+	NavMesh->GetNavMeshTilesIn({ DirtyBounds }, Tiles);
+	
+	InvalidateTiles(Tiles);
+	PendingDirtyTiles.Append(Tiles);
+}
+
+void UNavAwareCacheSubsystem::RemoveEntry(const FNavAwareCacheKey& Key)
+{
+	const FNavAwareCacheEntry* Entry = CachedResults.Find(Key);
+	if (Entry == nullptr) return;
+
+	for (const int32 Tile : Entry->Tiles)
+	{
+		KeysByTile.RemoveSingle(Tile, Key);
+	}
+	LruList.RemoveNode(Entry->LruNode);
+	CachedResults.Remove(Key);
+}
+
+void UNavAwareCacheSubsystem::GatherQueryTiles(const ARecastNavMesh* NavMesh, const FVector& Origin, float Radius, int32 StartTile, TArray<int32>& OutTiles)
+{
+	const TArray<FBox> QueryBounds = { FBox::BuildAABB(Origin, FVector(Radius)) };
+	NavMesh->GetNavMeshTilesIn(QueryBounds, OutTiles);
+	if (StartTile != INDEX_NONE)
+	{
+		OutTiles.AddUnique(StartTile);
+	}
+}
+
+void UNavAwareCacheSubsystem::EvictLeastRecentlyUsed()
+{
+	if (const FNavAwareCacheLruList::TDoubleLinkedListNode* Tail = LruList.GetTail())
+	{
+		const FNavAwareCacheKey Key = Tail->GetValue();
+		RemoveEntry(Key);
+	}
+}
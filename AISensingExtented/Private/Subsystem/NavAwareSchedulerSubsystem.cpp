@@ -0,0 +1,123 @@
+﻿#include "Subsystem/NavAwareSchedulerSubsystem.h"
+
+#include "Actor/NavAwareEnhancedBase.h"
+#include "NavAwareStats.h"
+#include "GameFramework/PlayerController.h"
+#include "GameFramework/Pawn.h"
+
+
+void UNavAwareSchedulerSubsystem::Tick(float DeltaTime)
+{
+	Super::Tick(DeltaTime);
+
+	if (PendingRequests.Num() == 0) return;
+
+	const UWorld* World = GetWorld();
+	const double Now = World->GetTimeSeconds();
+
+	FVector PlayerLocation = FVector::ZeroVector;
+	bool bHasPlayer = false;
+	if (const APlayerController* PC = World->GetFirstPlayerController())
+	{
+		if (const APawn* PlayerPawn = PC->GetPawn())
+		{
+			PlayerLocation = PlayerPawn->GetActorLocation();
+			bHasPlayer = true;
+		}
+	}
+
+	/*
+	 * Staleness changes every frame, so priorities are refreshed and the heap is rebuilt once per tick
+	 */
+	RequestHeap.Reset(PendingRequests.Num());
+	for (auto It = PendingRequests.CreateIterator(); It; ++It)
+	{
+		if (!It.Key().IsValid())
+		{
+			It.RemoveCurrent();
+			continue;
+		}
+		//stays queued until the agent's async query is in, running it now would block on that query
+		if (It.Key()->IsAsyncQueryPending()) continue;
+		
+		FNavAwareRequest& Request = It.Value();
+		Request.Priority = CalcPriority(Request, PlayerLocation, bHasPlayer, Now);
+		RequestHeap.Add(Request);
+	}
+
+	const auto HigherPriority = [](const FNavAwareRequest& A, const FNavAwareRequest& B)
+	{
+		return A.Priority > B.Priority;
+	};
+	RequestHeap.Heapify(HigherPriority);
+
+	const double BudgetSeconds = FrameBudgetMs * 0.001;
+	const double StartTime = FPlatformTime::Seconds();
+	
+	while (RequestHeap.Num() > 0)
+	{
+		FNavAwareRequest Request;
+		RequestHeap.HeapPop(Request, HigherPriority, EAllowShrinking::No);
+		PendingRequests.Remove(Request.Agent);
+
+		if (ANavAwareEnhancedBase* Agent = Request.Agent.Get())
+		{
+			Agent->FindNearestEdges(Request.bDebug, Request.Radius);
+		}
+
+		if (FPlatformTime::Seconds() - StartTime >= BudgetSeconds)
+		{
+			break;
+		}
+	}
+}
+
+TStatId UNavAwareSchedulerSubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UNavAwareSchedulerSubsystem, STATGROUP_NavAware);
+}
+
+bool UNavAwareSchedulerSubsystem::DoesSupportWorldType(const EWorldType::Type WorldType) const
+{
+	return WorldType == EWorldType::Game || WorldType == EWorldType::PIE;
+}
+
+void UNavAwareSchedulerSubsystem::EnqueueRequest(ANavAwareEnhancedBase* Agent, float Urgency, float Radius, bool bDebug)
+{
+	if (Agent == nullptr) return;
+
+	FNavAwareRequest* Existing = PendingRequests.Find(Agent);
+	if (Existing)
+	{
+		Existing->Urgency = FMath::Max(Existing->Urgency, Urgency);
+		Existing->Radius = Radius;
+		Existing->bDebug |= bDebug;
+		return;
+	}
+
+	FNavAwareRequest& Request = PendingRequests.Add(Agent);
+	Request.Agent = Agent;
+	Request.Urgency = Urgency;
+	Request.Radius = Radius;
+	Request.bDebug = bDebug;
+}
+
+void UNavAwareSchedulerSubsystem::CancelRequest(const ANavAwareEnhancedBase* Agent)
+{
+	PendingRequests.Remove(const_cast<ANavAwareEnhancedBase*>(Agent));
+}
+
+float UNavAwareSchedulerSubsystem::CalcPriority(const FNavAwareRequest& Request, const FVector& PlayerLocation, bool bHasPlayer, double Now) const
+{
+	const ANavAwareEnhancedBase* Agent = Request.Agent.Get();
+	
+	const float Staleness = FMath::Min(static_cast<float>(Now - Agent->GetLastResultTime()), MaxStaleness);
+	float Priority = UrgencyWeight * Request.Urgency + StalenessWeight * Staleness;
+	
+	if (bHasPlayer)
+	{
+		Priority -= DistanceWeight * FVector::Dist(Agent->GetActorLocation(), PlayerLocation) / 1000.f;
+	}
+	
+	return Priority;
+}
@@ -0,0 +1,146 @@
+﻿#include "Subsystem/SensingSchedulerSubsystem.h"
+
+#include "Component/SensingComponentExtented.h"
+#include "GameFramework/PlayerController.h"
+#include "GameFramework/Pawn.h"
+
+
+static bool SlotDueEarlier(const FSensingSlot& A, const FSensingSlot& B)
+{
+	return A.NextUpdateTime < B.NextUpdateTime;
+}
+
+void USensingSchedulerSubsystem::Initialize(FSubsystemCollectionBase& Collection)
+{
+	Super::Initialize(Collection);
+
+	LineOfSightCache.Configure(LineOfSightCacheCellSize, LineOfSightCacheTimeToLive);
+}
+
+void USensingSchedulerSubsystem::Tick(float DeltaTime)
+{
+	Super::Tick(DeltaTime);
+
+	const UWorld* World = GetWorld();
+	const double Now = World->GetTimeSeconds();
+
+	//every answer is expired after one time to live, purging more often than that finds nothing
+	if (Now - LastLineOfSightCachePurge > LineOfSightCache.GetTimeToLive())
+	{
+		LineOfSightCache.Purge(Now);
+		LastLineOfSightCachePurge = Now;
+	}
+	
+	LastLineOfSightChecks = 0;
+	if (Slots.Num() == 0) return;
+
+	FVector PlayerLocation = FVector::ZeroVector;
+	bool bHasPlayer = false;
+	if (const APlayerController* PC = World->GetFirstPlayerController())
+	{
+		if (const APawn* PlayerPawn = PC->GetPawn())
+		{
+			PlayerLocation = PlayerPawn->GetActorLocation();
+			bHasPlayer = true;
+		}
+	}
+
+	//overdue sensors keep their place at the top, so nobody starves when the budget runs out
+	int32 NumPasses = 0;
+	while (Slots.Num() > 0 && Slots.HeapTop().NextUpdateTime <= Now)
+	{
+		if (NumPasses > 0 && LastLineOfSightChecks >= MaxLineOfSightChecksPerFrame)
+		{
+			break;
+		}
+		
+		FSensingSlot Slot;
+		Slots.HeapPop(Slot, SlotDueEarlier, EAllowShrinking::No);
+
+		USensingComponentExtented* Sensor = Slot.Sensor.Get();
+		const uint32* Registration = Registrations.Find(Slot.Sensor);
+		if (Sensor == nullptr || Registration == nullptr || *Registration != Slot.Registration)
+		{
+			continue;
+		}
+
+		if (Sensor->IsSensingEnabled())
+		{
+			LastLineOfSightChecks += Sensor->RunSensingPass();
+			++NumPasses;
+		}
+		
+		Slot.NextUpdateTime = Now + CalcInterval(*Sensor, PlayerLocation, bHasPlayer);
+		Slots.HeapPush(Slot, SlotDueEarlier);
+	}
+}
+
+TStatId USensingSchedulerSubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(USensingSchedulerSubsystem, STATGROUP_Tickables);
+}
+
+bool USensingSchedulerSubsystem::DoesSupportWorldType(const EWorldType::Type WorldType) const
+{
+	return WorldType == EWorldType::Game || WorldType == EWorldType::PIE;
+}
+
+const FSensingPawnGrid& USensingSchedulerSubsystem::GetPawnGrid()
+{
+	if (PawnGridFrame != GFrameCounter)
+	{
+		PawnGrid.Build(GetWorld(), PawnGridCellSize);
+		PawnGridFrame = GFrameCounter;
+	}
+	return PawnGrid;
+}
+
+void USensingSchedulerSubsystem::RegisterSensor(USensingComponentExtented* Sensor)
+{
+	if (Sensor == nullptr || Registrations.Contains(Sensor)) return;
+
+	const uint32 Registration = ++NumRegistrations;
+	Registrations.Add(Sensor, Registration);
+
+	//golden ratio phases spread any number of sensors evenly over their first interval
+	const float Phase = FMath::Frac(Registration * 0.618034f);
+	
+	FSensingSlot Slot;
+	Slot.Sensor = Sensor;
+	Slot.NextUpdateTime = GetWorld()->GetTimeSeconds() + Phase * Sensor->SensingInterval;
+	Slot.Registration = Registration;
+	Slots.HeapPush(Slot, SlotDueEarlier);
+}
+
+void USensingSchedulerSubsystem::UnregisterSensor(const USensingComponentExtented* Sensor)
+{
+	//its slot is dropped once it reaches the top of the heap
+	Registrations.Remove(const_cast<USensingComponentExtented*>(Sensor));
+}
+
+float USensingSchedulerSubsystem::CalcInterval(const USensingComponentExtented& Sensor, const FVector& PlayerLocation, bool bHasPlayer) const
+{
+	float Interval = Sensor.SensingInterval;
+	
+	if (bHasPlayer && LODFarDistance > LODNearDistance)
+	{
+		const AActor* Owner = Sensor.GetOwner();
+		const float Distance = Owner ? FVector::Dist(Owner->GetActorLocation(), PlayerLocation) : 0.f;
+		const float Alpha = FMath::Clamp((Distance - LODNearDistance) / (LODFarDistance - LODNearDistance), 0.f, 1.f);
+		Interval *= FMath::Lerp(1.f, FarIntervalScale, Alpha);
+	}
+
+	//a noise older than HearingMaxSoundAge isn't relevant anymore, passes further apart would miss it for good
+	if (Sensor.bHearNoises)
+	{
+		Interval = FMath::Min(Interval, FMath::Max(Sensor.HearingMaxSoundAge, Sensor.SensingInterval));
+	}
+	
+	if (Sensor.IsAlerted())
+	{
+		Interval *= AlertIntervalScale;
+	}
+	
+	//never rerun within the same frame
+	return FMath::Max(Interval, KINDA_SMALL_NUMBER);
+}
@@ -0,0 +1,31 @@
+﻿#pragma once
+
+#include "CoreMinimal.h"
+#include "GameFramework/Actor.h"
+#include "NavAwareDebugRenderer.generated.h"
+
+class UNavAwareDebugRenderComponent;
+
+/*
+ * Transient holder of the one UNavAwareDebugRenderComponent every NavAware agent of a world draws into,
+ * spawned by the first agent that debugs
+ */
+UCLASS(Transient, NotPlaceable)
+class AISENSINGEXTENTED_API ANavAwareDebugRenderer : public AActor
+{
+	GENERATED_BODY()
+
+public:
+	ANavAwareDebugRenderer();
+
+	/*
+	 * Finds the renderer of given world, spawns it when there is none yet
+	 */
+	static ANavAwareDebugRenderer* Get(UWorld* World);
+
+	FORCEINLINE UNavAwareDebugRenderComponent* GetRenderComponent() const { return RenderComponent; }
+
+private:
+	UPROPERTY(VisibleAnywhere, Category= "Debug")
+	TObjectPtr<UNavAwareDebugRenderComponent> RenderComponent;
+};
@@ -6,12 +6,23 @@
 #include "StainMathLibrary.h"
 #include "GameFramework/Actor.h"
 #include "NavMesh/RecastNavMesh.h"
+#include "Engine/LatentActionManager.h"
+#include "Tasks/Task.h"
+#include "NavAwareStats.h"
+#include "NavAwareTrace.h"
 
 #include "NavAwareEnhancedBase.generated.h"
 
 DECLARE_LOG_CATEGORY_EXTERN(NavAware, Log, All);
 
 class ARecastNavMesh;
+class UNavAwareCacheSubsystem;
+class FNavAwareEdgeGrid;
+struct FNavAwareEdgeStore;
+struct FNavAwareIncrementalState;
+class FNavAwareEdgeDiff;
+class ANavAwareDebugRenderer;
+struct FNavAwareCacheKey;
 
 UENUM(BlueprintType)
 enum class EWallType : uint8
@@ -32,6 +43,10 @@ enum class ECornerCheck : uint8
 };
 
 
+/*
+ * Blueprint facing view of one edge, filled from FNavAwareEdgeStore once the pipeline is done.
+ * EdgeID is the edge's index in WallEdges, Prev/Next are indices too, INDEX_NONE when there is none
+ */
 USTRUCT(BlueprintType)
 struct FNavPoint
 {
@@ -44,83 +59,149 @@ struct FNavPoint
 	FVector End = FVector::ZeroVector;;
 	
 	UPROPERTY(BlueprintReadWrite, Category="Navigation")
-	uint8 EdgeID = 0;
+	int32 EdgeID = 0;
 	
 	UPROPERTY(BlueprintReadWrite, Category="Navigation")
-	uint8 LineID = 0;
+	int32 LineID = 0;
 
 	UPROPERTY(BlueprintReadWrite, Category="Navigation")
 	EWallType Type = EWallType::Wall;
 
+	/*Turning degree to the next edge, 0 without one*/
 	UPROPERTY(BlueprintReadWrite, Category="Navigation")
 	float Degree = 0;
 
-	FNavPoint* PrevEdge;
-	FNavPoint* NextEdge;
+	UPROPERTY(BlueprintReadWrite, Category="Navigation")
+	int32 PrevEdge = INDEX_NONE;
+	
+	UPROPERTY(BlueprintReadWrite, Category="Navigation")
+	int32 NextEdge = INDEX_NONE;
 
 	FORCEINLINE FNavPoint(const FVector& InStart = FVector::ZeroVector, const FVector& InEnd = FVector::ZeroVector,
-		uint8 InEdgeID = 0, uint8 InLineID = 0, EWallType InType = EWallType::Wall, float InDegree = 0.f, FNavPoint* InPrevEdge = nullptr, FNavPoint* InNextEdge = nullptr)
+		int32 InEdgeID = 0, int32 InLineID = 0, EWallType InType = EWallType::Wall, float InDegree = 0.f, int32 InPrevEdge = INDEX_NONE, int32 InNextEdge = INDEX_NONE)
 		: Start(InStart), End(InEnd), EdgeID(InEdgeID), LineID(InLineID), Type(InType), Degree(InDegree), PrevEdge(InPrevEdge), NextEdge(InNextEdge)
 	{
 	}
 };
 
+/*
+ * Connected corner edges from CornerStart to CornerEnd, both are edge indices
+ */
 USTRUCT(BlueprintType)
 struct FCorner
 {
 	GENERATED_BODY()
 	
-	FNavPoint* CornerStart = nullptr;
+	UPROPERTY(BlueprintReadOnly, Category="Navigation")
+	int32 CornerStart = INDEX_NONE;
 	
-	FNavPoint* CornerEnd = nullptr;
+	UPROPERTY(BlueprintReadOnly, Category="Navigation")
+	int32 CornerEnd = INDEX_NONE;
 
-	uint8 CornerID = 0;
+	UPROPERTY(BlueprintReadOnly, Category="Navigation")
+	int32 CornerID = 0;
 	
-	FORCEINLINE FCorner(FNavPoint* InStart = nullptr, FNavPoint* InEnd = nullptr, uint8 InID = 0)
+	FORCEINLINE FCorner(int32 InStart = INDEX_NONE, int32 InEnd = INDEX_NONE, int32 InID = 0)
 		:CornerStart(InStart), CornerEnd(InEnd), CornerID(InID)
 	{
 	}
 };
 
+/*
+ * Entry from a corner's line to another line, EdgeA/EdgeB are edge indices
+ */
 USTRUCT(BlueprintType)
 struct FEntry
 {
 	GENERATED_BODY()
 	
-	uint8* CornerID = 0;
-	uint8* CurrentLineID = 0;
-	uint8* TargetLineID = 0;
+	UPROPERTY(BlueprintReadOnly, Category="Navigation")
+	int32 CornerID = 0;
+	
+	UPROPERTY(BlueprintReadOnly, Category="Navigation")
+	int32 CurrentLineID = 0;
+	
+	UPROPERTY(BlueprintReadOnly, Category="Navigation")
+	int32 TargetLineID = 0;
 
-	FNavPoint* EdgeA = nullptr;
+	UPROPERTY(BlueprintReadOnly, Category="Navigation")
+	int32 EdgeA = INDEX_NONE;
 
-	FNavPoint* EdgeB = nullptr;
+	UPROPERTY(BlueprintReadOnly, Category="Navigation")
+	int32 EdgeB = INDEX_NONE;
 	
+	UPROPERTY(BlueprintReadOnly, Category="Navigation")
 	FVector Start = FVector::ZeroVector;
 
+	UPROPERTY(BlueprintReadOnly, Category="Navigation")
 	FVector End = FVector::ZeroVector;
 	
+	UPROPERTY(BlueprintReadOnly, Category="Navigation")
 	float Width = 0.f;
 
+	UPROPERTY(BlueprintReadOnly, Category="Navigation")
 	FVector Location = FVector::ZeroVector;
 
 	//reload operator==: only check if both has the same LineIDs, order is not necessary
 	bool operator==(const FEntry& Other) const
 	{
-		return (*CurrentLineID == *Other.CurrentLineID && *TargetLineID == *Other.TargetLineID) ||
-			   (*CurrentLineID == *Other.TargetLineID && *TargetLineID == *Other.CurrentLineID);
+		return (CurrentLineID == Other.CurrentLineID && TargetLineID == Other.TargetLineID) ||
+			   (CurrentLineID == Other.TargetLineID && TargetLineID == Other.CurrentLineID);
+	}
+};
+
+/*
+ * One full result of the awareness pipeline.
+ * Everything links by index, so results can be copied and moved around freely
+ */
+struct FNavAwareResult
+{
+	TArray<FNavPoint> WallEdges;
+	TArray<FCorner> Corners;
+	TArray<FEntry> Entries;
+
+	FORCEINLINE void Reset()
+	{
+		Entries.Reset();
+		Corners.Reset();
+		WallEdges.Reset();
 	}
 };
 
+/*
+ * Everything the pipeline reads off the actor, copied on the game thread before a query starts.
+ * Stages only read this, so tunables and the navmesh can change while a query runs on a worker
+ */
+struct FNavAwarePipelineSettings
+{
+	const ARecastNavMesh* NavMesh = nullptr;
+	float MaxDistForFakeCorner = 250.f;
+	float MinCurDeg = 35.f;
+	float MinCompens = 45.f;
+	float CornerBlur = 500.f;
+	float MaxEntryWidth = 1000.f;
+	float EdgeWeldTolerance = 1.f;
+	uint32 SettingsHash = 0;
+};
+
+DECLARE_DYNAMIC_MULTICAST_DELEGATE_OneParam(FOnNearestEdgesUpdated, ANavAwareEnhancedBase*, NavAware);
+
 UCLASS()
 class AISENSINGEXTENTED_API ANavAwareEnhancedBase : public AActor
 {
 	GENERATED_BODY()
 
+#if WITH_EDITOR
+	//the only way to the stages from outside, see below
+	friend struct FNavAwarePipelineStages;
+#endif
+
 public:
 	ANavAwareEnhancedBase();
 
 protected:
 	virtual void BeginPlay() override;
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
 
 public:
 	virtual void Tick(float DeltaTime) override;
@@ -171,100 +252,333 @@ protected:
 	UPROPERTY(EditAnywhere, Category= "TerranInfo|Edge Detection")
 	float CornerBlur = 500.f;
 
+	/*Edges further away than this are never looked at when searching entries from a corner*/
+	UPROPERTY(EditAnywhere, Category= "TerranInfo|Edge Detection")
+	float MaxEntryWidth = 1000.f;
+
+	/*Tail and head closer than this are treated as connected when edges are chained into lines*/
+	UPROPERTY(EditAnywhere, Category= "TerranInfo|Edge Detection")
+	float EdgeWeldTolerance = 1.f;
+
+	/*
+	 * Reuse results of past queries from the same spot through UNavAwareCacheSubsystem.
+	 * A hit is the result of another origin in the same cell, not what a query right here returns
+	 */
+	UPROPERTY(EditAnywhere, Category= "TerranInfo|Cache")
+	bool bUseAwarenessCache = false;
+
 	/*
-	 * Find walls & corners around
+	 * Read results from the level's baked awareness data when the query matches BakeRadius
+	 * and starts close enough to a cell's bake origin, see UNavAwareCacheSubsystem's BakedOriginToleranceScale.
+	 * The result is the one of the bake origin, not of the query's
+	 */
+	UPROPERTY(EditAnywhere, Category= "TerranInfo|Cache")
+	bool bUseBakedData = false;
+
+	/*
+	 * Diff every query against the last one of this actor, only lines and corners near the changed edges are reclassified.
+	 * "-run=NavAwareBenchmark" checks it against a full run
+	 */
+	UPROPERTY(EditAnywhere, Category= "TerranInfo|Cache")
+	bool bIncrementalUpdate = false;
+
+	/*
+	 * Publish every result as UAISense_NavAwareness stimuli, listeners around share this actor's queries.
+	 * Nothing is built while no perception component uses the sense
+	 */
+	UPROPERTY(EditAnywhere, Category= "TerranInfo|Perception")
+	bool bReportToPerception = false;
+
+	/*Radius every cell is baked with, only queries with the same radius read baked data*/
+	UPROPERTY(EditAnywhere, Category= "TerranInfo|Bake")
+	float BakeRadius = 550.f;
+
+	/*One result is baked per cell of this size, from the first navmesh poly center found in it*/
+	UPROPERTY(EditAnywhere, Category= "TerranInfo|Bake")
+	float BakeCellSize = 200.f;
+
+#if WITH_EDITOR
+	/*
+	 * Runs the pipeline over the whole navmesh of this level and writes the results to Content/NavAware/<MapName>.navaware
+	 */
+	UFUNCTION(CallInEditor, Category= "TerranInfo|Bake")
+	void BakeAwarenessData();
+
+	/*
+	 * Saves what FindEdges returns around this actor (radius BakeRadius) to Saved/NavAware/Fixtures, the benchmark commandlet picks it up from there
+	 */
+	UFUNCTION(CallInEditor, Category= "TerranInfo|Benchmark")
+	void RecordEdgeFixture();
+#endif
+
+	/*
+	 * Find walls & corners around, does nothing while an async query is pending
 	 */
 	UFUNCTION(BlueprintCallable)
 	void FindNearestEdges(bool bDebug = false, float radius = 550.f);
+
+	/*
+	 * Same as FindNearestEdges, but the pipeline runs as a task on worker threads.
+	 * Results are written into a back buffer and swapped into WallEdges/Corners/Entries on the game thread when done.
+	 * Calling it while a query is still in flight does not start a new one, the node completes with the pending query
+	 */
+	UFUNCTION(BlueprintCallable, meta = (Latent, LatentInfo = "LatentInfo"))
+	void FindNearestEdgesAsync(FLatentActionInfo LatentInfo, bool bDebug = false, float radius = 550.f);
+
+	UFUNCTION(BlueprintPure, Category= "TerranInfo")
+	FORCEINLINE bool IsAsyncQueryPending() const { return bAsyncQueryPending; }
+
+	/*
+	 * Queue a FindNearestEdges call with the world's UNavAwareSchedulerSubsystem instead of running it right away,
+	 * the scheduler runs queued queries under a per-frame time budget, higher urgency runs earlier
+	 */
+	UFUNCTION(BlueprintCallable)
+	void RequestAwarenessUpdate(float Urgency = 1.f, bool bDebug = false, float radius = 550.f);
 	
 public:
+	/*Fires on the game thread every time WallEdges/Corners/Entries are replaced with a new result*/
+	UPROPERTY(BlueprintAssignable, Category= "TerranInfo")
+	FOnNearestEdgesUpdated OnNearestEdgesUpdated;
+
+	/*World time of the last result swapped in*/
+	FORCEINLINE double GetLastResultTime() const { return LastResultTime; }
+
+	FORCEINLINE uint32 GetAsyncQuerySerial() const { return AsyncQuerySerial; }
+	FORCEINLINE uint32 GetCompletedAsyncQuerySerial() const { return CompletedAsyncQuerySerial; }
+
+	/*Formats the trace events of the last finished query to the log, does nothing in shipping builds*/
+	void DumpLastQueryTrace() const;
+
+	/*
+	 * Fill Degree of every edge that has a next edge, the classification itself works on FXYTurn
+	 */
+	static void FillEdgeDegrees(TArray<FNavPoint>& InOutArray);
+	
 private:
+
+	/*
+	 * Runs the whole pipeline from FindEdges to TakeSteps into OutResult.
+	 * Doesn't touch WallEdges/Corners/Entries, so it is safe to be called from a worker thread.
+	 * Given an incremental state, the new edges are diffed against it and it is replaced with this query afterwards.
+	 * Given a start poly, e.g. the one of the cache key, FindEdges starts from it instead of looking for the nearest poly again
+	 */
+	void RunPipeline(const FVector& Origin, float Radius, FSharedConstNavQueryFilter QueryFilter, FNavAwareResult& OutResult,
+		FNavAwareIncrementalState* Incremental = nullptr, uint32 NavSerial = 0, NavNodeRef StartPoly = INVALID_NAVNODEREF);
+
+	/*
+	 * Everything of RunPipeline after FindEdges, from GatherEdgesWithSorting to TakeSteps
+	 */
+	void ClassifyEdges(TArray<FNavigationWallEdge>& InEdges, const FVector& Origin, float Radius, FNavAwareResult& OutResult,
+		FNavAwareIncrementalState* Incremental = nullptr, uint32 NavSerial = 0);
+
+	/*
+	 * State to diff the next query against, nullptr when incremental update is off or the navmesh is building
+	 */
+	FNavAwareIncrementalState* GetIncrementalState();
+	
+	/*Changes whenever the navmesh under the cache is rebuilt, incremental state of an older serial is thrown away*/
+	uint32 GetNavSerial() const;
+
+	/*Changes only when a tile a query around Origin reads is rebuilt, see UNavAwareCacheSubsystem::GetAreaSerial*/
+	uint32 GetAreaSerial(const FVector& Origin, float Radius, int32 StartTile) const;
+
+	/*
+	 * Cache lookup & store around RunPipeline, game thread only.
+	 * A miss leaves the key of the lookup in OutKey, invalid without a cache, to store the result under it afterwards
+	 */
+	UNavAwareCacheSubsystem* GetAwarenessCache() const;
+	bool FindCachedResult(const FVector& Origin, float Radius, FNavAwareResult& OutResult, FNavAwareCacheKey& OutKey) const;
+	void StoreCachedResult(const FNavAwareCacheKey& Key, const FVector& Origin, float Radius, const FNavAwareResult& Result) const;
+
+	/*
+	 * Hash of every setting that changes the classification, results of different settings never share a cache entry
+	 */
+	uint32 GetPipelineSettingsHash() const;
+
+	/*
+	 * Copies the tunables and current navmesh into QuerySettings, game thread only and never while an async query is pending
+	 */
+	void SnapshotPipelineSettings();
+
+	/*
+	 * Hold navmesh rebuilds back through UNavAwareCacheSubsystem while the async query reads tiles
+	 */
+	bool AcquireNavBuildLock();
+	void ReleaseNavBuildLock();
+
+	/*
+	 * Swaps given result into WallEdges/Corners/Entries, game thread only
+	 */
+	void ApplyResult(FNavAwareResult& InResult, bool bDebug);
+
+	/*
+	 * Reports the corners and entries of the current result to AI perception, game thread only
+	 */
+	void ReportToPerception();
+
+	/*
+	 * Called on game thread when the async pipeline has filled the back buffer
+	 */
+	void OnAsyncQueryFinished(bool bDebug, const FVector& Origin, float Radius, uint32 AreaSerial, const FNavAwareCacheKey& CacheKey);
+
+	/*
+	 * Hands the current result to the world's shared debug renderer, where it stays until the next one
+	 */
+	void DrawDebugResult();
+
+	/*
+	 * Records the current result as Visual Logger shapes under NavAware, does nothing unless vislog is recording
+	 */
+	void VisLogResult() const;
+
+	TWeakObjectPtr<ANavAwareDebugRenderer> DebugRenderer;
+
+	/*What the running or last query reads, see SnapshotPipelineSettings*/
+	FNavAwarePipelineSettings QuerySettings;
+	
+	/*Back buffer written by the async query*/
+	FNavAwareResult BackBuffer;
+	UE::Tasks::FTask AsyncQueryTask;
+	bool bAsyncQueryPending = false;
+	bool bHoldsNavBuildLock = false;
+	uint32 AsyncQuerySerial = 0;
+	uint32 CompletedAsyncQuerySerial = 0;
+
+	double LastResultTime = 0.0;
+
+	/*Created on first use, shared so the header doesn't need the full type*/
+	TSharedPtr<FNavAwareIncrementalState> IncrementalState;
+	FCriticalSection IncrementalSection;
+
+#if NAVAWARE_WITH_TRACE
+	/*Copy of the trace buffer of the last finished query*/
+	FNavAwareTraceBuffer LastQueryTrace;
+	mutable FCriticalSection LastQueryTraceSection;
+#endif
 	
 	/*
 	 * Takes in an TArray<FNavigationWallEdge>, sorts element in the order of head & tail, into separate lines.
+	 * Endpoints closer than EdgeWeldTolerance are linked through a quantized hash, runs in O(n).
+	 * OutEdges stores them relative to Origin
 	 */
-	void GatherEdgesWithSorting(TArray<FNavigationWallEdge>& InArray, TArray<FNavPoint>& TempArray, bool bDebug = false);
+	void GatherEdgesWithSorting(TArray<FNavigationWallEdge>& InArray, const FVector& Origin, FNavAwareEdgeStore& OutEdges, bool bDebug = false);
 	FCriticalSection GatherSortingEdgesSection;
 
 	/*
-	 * Make array a chain that every edge contains address of their prev and next edge
+	 * Make array a chain that every edge contains index of their prev and next edge
 	 */
-	void EdgeLinker(TArray<FNavPoint>& InOutArray);
+	void EdgeLinker(FNavAwareEdgeStore& InOutEdges);
 
 	/*
-	 * Caller function to add corner & wall and so on information for an TArray<FNavPoint>;
+	 * Caller function to add corner & wall and so on information for every edge of the store;
+	 * Given DirtyLines, only lines flagged there are marked, MarkEntryEdges & FilterOnlyInnerEdge take it the same way
 	 */
-	void MarkCorner(TArray<FNavPoint>& InOutArray);
+	void MarkCorner(FNavAwareEdgeStore& InOutEdges, const TBitArray<>* DirtyLines = nullptr);
 	FCriticalSection MarkingCornerSection;
 	
 	/*
-	 * Takes into two edges: current & next, and calculate current edge's degree.
-	 * In the meantime check if it is fake
+	 * Takes in current edge's turn to the next edge, check if it is a corner.
+	 * In the meantime check if it is fake, by its last edge's turn
 	 */
-	void DetectCorner(TArray<FNavPoint>& InOutArray, FNavPoint& CurEdge, FNavPoint& NextEdge, FNavPoint& LastEdge, float& curDeg, float& lastDeg, uint8 i) const;
+	void DetectCorner(FNavAwareEdgeStore& InOutEdges, int32 CurEdge, const FXYTurn& CurTurn, const FXYTurn& LastTurn, float CosMinCurDeg, float CosMinCompens) const;
 
 
 	/*
 	 * Filter out the outer edges from a curves, which won't be needed to calculate the cross road entries
 	 */
-	void FilterOnlyInnerEdge(TArray<FNavPoint>& InOutArray);
+	void FilterOnlyInnerEdge(FNavAwareEdgeStore& InOutEdges, const TBitArray<>* DirtyLines = nullptr);
 	FCriticalSection FilterSection;
 	
 	/*
 	 * Mark road entries
 	 */
-	void MarkEntryEdges(TArray<FNavPoint>& InOutArray);
+	void MarkEntryEdges(FNavAwareEdgeStore& InOutEdges, const TBitArray<>* DirtyLines = nullptr);
 	FCriticalSection MarkingEntrySection;
 
 	/*
 	 * Make connected corners into a corner groups, into an array
 	 */
-	void MakeCornerArray(TArray<FNavPoint>& InArray, TArray<FCorner>& OutCorners);
+	void MakeCornerArray(const FNavAwareEdgeStore& InEdges, TArray<FCorner>& OutCorners);
 	FCriticalSection MakeCornerArraySection;
 	
 	/*
 	 * Looping through the array, find corner and out entries and do follow things:
-	 * For every said above edges, we make a new array that stores none family edges, in the order of distance
+	 * For every said above edges, we make a new array that stores none family edges, in the order of distance.
+	 * Given the last query and its diff, corners away from the changed edges copy what they found last time.
+	 * OutCornerEntries receives the entries of every corner before deduplication, for the next diff
+	 */
+	void TakeSteps(const FNavAwareEdgeStore& InEdges, TArray<FCorner>& InCorners, TArray<FEntry>& OutEntries, bool bDebug = false,
+		const FNavAwareIncrementalState* Previous = nullptr, const FNavAwareEdgeDiff* Diff = nullptr, TArray<TArray<FEntry>>* OutCornerEntries = nullptr);
+
+	/*Scratch of TakeSteps, reused by every edge*/
+	struct FStepScratch
+	{
+		TArray<int32> NearestEdges;
+		FSegmentSoA TargetSegments;
+		FSegmentBatchResult ClosestPoints;
+	};
+
+	/*
+	 * Entries from every edge of one corner to other lines, at most one per line
 	 */
-	void TakeSteps(TArray<FNavPoint>& InOutArray, bool bDebug = false);
+	void FindCornerEntries(const FNavAwareEdgeStore& InEdges, const FCorner& CurCorner, const FNavAwareEdgeGrid& EdgeGrid, FStepScratch& Scratch, TArray<FEntry>& OutEntries);
 
 	/*
-	 *Filter the nearest edges to given edge, from given array
-	 *Optional: keep only one edge of each line
+	 * Copies the entries the same corner found last query, remapped onto the new edges.
+	 * Fails if the corner is new, or it is close enough to a changed edge that its entries may differ
 	 */
-	void SortEdgesByDistanceToGivenEdge(const FNavPoint& CurEdge, TArray<FNavPoint>& EdgesCollection, TArray<FNavPoint*>& OutArray, bool bOnlyOneForEachLine = true);
+	bool ReuseCornerEntries(const FNavAwareEdgeStore& InEdges, const FCorner& CurCorner, const FNavAwareIncrementalState& Previous,
+		const FNavAwareEdgeDiff& Diff, const TMap<int32, int32>& OldCornerByStart, TArray<FEntry>& OutEntries) const;
+
+	/*
+	 *Filter the nearest edge of each other line to given edge index, sorted by distance
+	 *Asks the grid built once per TakeSteps, only edges within MaxEntryWidth are returned
+	 */
+	void SortEdgesByDistanceToGivenEdge(int32 CurEdge, const FNavAwareEdgeGrid& EdgeGrid, TArray<int32>& OutArray);
 
 public:
 	
-	FORCEINLINE bool CheckCorner(const float& curDeg) const
+	/*
+	 * |degree| >= minCurDeg, compared as cos(degree) <= cos(minCurDeg)
+	 */
+	static FORCEINLINE bool CheckCorner(const FXYTurn& CurTurn, float CosMinCurDeg)
 	{
-		return curDeg >= minCurDeg || curDeg <= -minCurDeg;
+		return CurTurn.Sin != 0.f && CurTurn.Cos <= CosMinCurDeg;
 	};
 	
 	/*
-	 * Check if current corner is fake, when last degree != 0.f,
+	 * Check if current corner is fake, when last turn != 0,
 	 * in another word, this edge is not the first of the current array/line,
-	 * use compensation of the 'last' edge's degree and 'current' edge's
+	 * use compensation of the 'last' edge's turn and 'current' edge's: |last + cur| < minCompens.
+	 * The sum is formed by angle addition, turns in the same direction may add up past 180, which the sine tells apart
 	 */
-	template <typename T>
-	FORCEINLINE bool CheckFakeCorner(T& curDeg, T& lastDeg) const
+	static FORCEINLINE bool CheckFakeCorner(const FXYTurn& CurTurn, const FXYTurn& LastTurn, float CosMinCompens)
 	{
-		const float Compensation = FMath::Abs(static_cast<float>(lastDeg) + static_cast<float>(curDeg));
-		return lastDeg != 0.f && Compensation < minCompens;
+		if (LastTurn.Sin == 0.f) return false;
+		
+		const float SumCos = CurTurn.Cos * LastTurn.Cos - CurTurn.Sin * LastTurn.Sin;
+		if ((CurTurn.Sin > 0.f) != (LastTurn.Sin > 0.f))
+		{
+			return SumCos > CosMinCompens;
+		}
+		
+		const float SumSin = FMath::Abs(CurTurn.Sin) * LastTurn.Cos + CurTurn.Cos * FMath::Abs(LastTurn.Sin);
+		return SumSin >= 0.f && SumCos > CosMinCompens;
 	}
 
 	/*Only can be used on edge!
 	 * Need to check if return vector if is zero vector!
 	 */
-	FORCEINLINE FVector GetEdgePolyCenter(const FNavPoint& Edge, NavNodeRef* OutPoly = nullptr) const
+	FORCEINLINE FVector GetEdgePolyCenter(const FVector& EdgeStart, const FVector& EdgeEnd, NavNodeRef* OutPoly = nullptr) const
 	{
-		FVector OutVector;
-		if (MainRecastNavMesh)
+		FVector OutVector = FVector::ZeroVector;
+		if (const ARecastNavMesh* NavMesh = QuerySettings.NavMesh)
 		{
-			const NavNodeRef Poly = MainRecastNavMesh->FindNearestPoly((Edge.Start + Edge.End)/2, FVector(50.f, 50.f, 50.f));
+			const NavNodeRef Poly = NavMesh->FindNearestPoly((EdgeStart + EdgeEnd)/2, FVector(50.f, 50.f, 50.f));
+			INC_DWORD_STAT(STAT_NavAware_FindNearestPolyCalls);
 			if (OutPoly) *OutPoly = Poly;
 		
-			MainRecastNavMesh->GetPolyCenter(Poly, OutVector);
+			NavMesh->GetPolyCenter(Poly, OutVector);
 		}
 	
 		return OutVector;
@@ -273,51 +587,9 @@ public:
 	/*
 	 * Return type of neighbor edges
 	 */
-	static FORCEINLINE ECornerCheck CheckNeighborCorner(const FNavPoint& Edge)
-	{
-		const bool prevIsCorner = Edge.PrevEdge && Edge.PrevEdge->Type == EWallType::Corner;
-		const bool nextIsCorner = Edge.NextEdge && Edge.NextEdge->Type == EWallType::Corner;
-		
-		if (prevIsCorner && nextIsCorner)
-		{
-			return ECornerCheck::BothAreCorner;
-		}
-		if (!prevIsCorner && !nextIsCorner)
-		{
-			return ECornerCheck::None;
-		}
-		if (prevIsCorner)
-		{
-			return ECornerCheck::PrevIsCorner;
-		}
-		if (nextIsCorner)
-		{
-			return ECornerCheck::NextIsCorner;
-		}
-		
-		return ECornerCheck::None;
-	}
+	static ECornerCheck CheckNeighborCorner(const FNavAwareEdgeStore& Edges, int32 Edge);
 
-	FORCEINLINE float GetEdgeNeighborDist(const FNavPoint& Edge)
-	{
-		float OutDistance = 0.f;
-		
-		const FVector CurEdgeMiddlePoint = (Edge.Start + Edge.End)/2;
-		
-		if (Edge.NextEdge)
-		{
-			const FVector NextEdgeMiddlePoint = (Edge.NextEdge->Start + Edge.NextEdge->End)/2;
-			OutDistance += (CurEdgeMiddlePoint - NextEdgeMiddlePoint).Length();
-		}
-		
-		if (Edge.PrevEdge)
-		{
-			const FVector PrevEdgeMiddlePoint = (Edge.PrevEdge->Start + Edge.PrevEdge->End)/2;
-			OutDistance += (CurEdgeMiddlePoint - PrevEdgeMiddlePoint).Length();
-		}
-		
-		return OutDistance;
-	}
+	static float GetEdgeNeighborDist(const FNavAwareEdgeStore& Edges, int32 Edge);
 
 	FORCEINLINE FVector TakeStepOnEdge(const FVector& Start, const FVector& End, float AmountPerStep, uint8 CurStep) const
 	{
@@ -348,14 +620,12 @@ public:
 		return false;
 	}
 
-	FORCEINLINE FVector GetPerpendicularLineFromPointOnEdgeInPolySide(const FVector& Point, const FNavPoint& Edge, const float Length = 50.f)
+	FORCEINLINE FVector GetPerpendicularLineFromPointOnEdgeInPolySide(const FVector& Point, const FVector& EdgeStart, const FVector& EdgeEnd, const float Length = 50.f)
 	{
-		const FVector EdgeStart = Edge.Start;
-		const FVector EdgeEnd = Edge.End;
 		//if (!CheckIfWithinEdge(EdgeStart, EdgeEnd, Point)) return FVector::ZeroVector;
 		
 		const FVector LineNormal = (EdgeEnd - EdgeStart).GetSafeNormal2D();
-		const FVector StartToPolyCenterN = (GetEdgePolyCenter(Edge) - EdgeStart).GetSafeNormal2D();
+		const FVector StartToPolyCenterN = (GetEdgePolyCenter(EdgeStart, EdgeEnd) - EdgeStart).GetSafeNormal2D();
 
 		const FVector PerpendicularLine = FRotator(0.f, 90.f * FMath::Sign(XYDegrees(LineNormal, StartToPolyCenterN)), 0.f).RotateVector(LineNormal);
 		
@@ -380,3 +650,23 @@ public:
 		return true;
 	}
 };
+
+#if WITH_EDITOR
+/*
+ * Runs single pipeline stages of an actor, for the benchmark commandlet to time them one by one.
+ * Editor builds only, nothing else is meant to call the stages out of order
+ */
+struct FNavAwarePipelineStages
+{
+	static FORCEINLINE void SnapshotSettings(ANavAwareEnhancedBase& Pipeline) { Pipeline.SnapshotPipelineSettings(); }
+	
+	static FORCEINLINE void GatherEdgesWithSorting(ANavAwareEnhancedBase& Pipeline, TArray<FNavigationWallEdge>& InArray, const FVector& Origin, FNavAwareEdgeStore& OutEdges) { Pipeline.GatherEdgesWithSorting(InArray, Origin, OutEdges); }
+	static FORCEINLINE void EdgeLinker(ANavAwareEnhancedBase& Pipeline, FNavAwareEdgeStore& InOutEdges) { Pipeline.EdgeLinker(InOutEdges); }
+	static FORCEINLINE void MarkCorner(ANavAwareEnhancedBase& Pipeline, FNavAwareEdgeStore& InOutEdges) { Pipeline.MarkCorner(InOutEdges); }
+	static FORCEINLINE void FilterOnlyInnerEdge(ANavAwareEnhancedBase& Pipeline, FNavAwareEdgeStore& InOutEdges) { Pipeline.FilterOnlyInnerEdge(InOutEdges); }
+	static FORCEINLINE void MarkEntryEdges(ANavAwareEnhancedBase& Pipeline, FNavAwareEdgeStore& InOutEdges) { Pipeline.MarkEntryEdges(InOutEdges); }
+	static FORCEINLINE void MakeCornerArray(ANavAwareEnhancedBase& Pipeline, const FNavAwareEdgeStore& InEdges, TArray<FCorner>& OutCorners) { Pipeline.MakeCornerArray(InEdges, OutCorners); }
+	static FORCEINLINE void ClassifyEdges(ANavAwareEnhancedBase& Pipeline, TArray<FNavigationWallEdge>& InEdges, const FVector& Origin, float Radius, FNavAwareResult& OutResult, FNavAwareIncrementalState* Incremental = nullptr) { Pipeline.ClassifyEdges(InEdges, Origin, Radius, OutResult, Incremental); }
+	static FORCEINLINE void TakeSteps(ANavAwareEnhancedBase& Pipeline, const FNavAwareEdgeStore& InEdges, TArray<FCorner>& InCorners, TArray<FEntry>& OutEntries) { Pipeline.TakeSteps(InEdges, InCorners, OutEntries); }
+};
+#endif
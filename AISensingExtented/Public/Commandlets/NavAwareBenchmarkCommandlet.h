@@ -0,0 +1,30 @@
+﻿#pragma once
+
+#include "CoreMinimal.h"
+#include "Commandlets/Commandlet.h"
+
+#include "NavAwareBenchmarkCommandlet.generated.h"
+
+/*
+ * Times every stage of the awareness pipeline on its own, headless:
+ * UnrealEditor-Cmd <Project> -run=NavAwareBenchmark [-sizes=10,100,1000,5000] [-iterations=50] [-fixtures=<Dir>] [-csv=<File>] [-baked=<File> [-bakedsamples=64]]
+ *
+ * Runs the synthetic fixtures at every size and each recorded fixture found in -fixtures (Saved/NavAware/Fixtures by default),
+ * reports ns per edge and allocations per run of each stage, and writes all rows to a csv for scaling curves.
+ * Allocations come from the allocator's call counters, 0 where the allocator doesn't keep them.
+ * There is no navmesh, so FilterOnlyInnerEdge gets a zero poly center for every edge and TakeSteps works on what that left:
+ * their rows are marked as not representative
+ * Given a baked awareness file, also reports which share of query origins its cells serve at several BakedOriginToleranceScale values.
+ * Before timing, checks that an incremental update returns what a full run does, and fails when it doesn't.
+ * Editor builds only, elsewhere Main just fails
+ */
+UCLASS()
+class AISENSINGEXTENTED_API UNavAwareBenchmarkCommandlet : public UCommandlet
+{
+	GENERATED_BODY()
+
+public:
+	UNavAwareBenchmarkCommandlet();
+	
+	virtual int32 Main(const FString& Params) override;
+};
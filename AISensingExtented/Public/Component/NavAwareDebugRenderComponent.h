@@ -0,0 +1,67 @@
+﻿#pragma once
+
+#include "CoreMinimal.h"
+#include "EngineDefines.h"
+#include "Debug/DebugDrawComponent.h"
+#include "DebugRenderSceneProxy.h"
+#include "NavAwareDebugRenderComponent.generated.h"
+
+/*
+ * Debug shapes are only built and drawn where debug drawing exists, compiled out of shipping builds.
+ * The types stay, so the renderer actor and its component resolve in every build
+ */
+#ifndef NAVAWARE_WITH_DEBUG_DRAW
+#define NAVAWARE_WITH_DEBUG_DRAW ENABLE_DRAW_DEBUG
+#endif
+
+/*
+ * Debug shapes of one agent's result, built once per result instead of once per frame
+ */
+struct AISENSINGEXTENTED_API FNavAwareDebugShapes
+{
+	TArray<FDebugRenderSceneProxy::FDebugLine> Lines;
+	TArray<FDebugRenderSceneProxy::FDebugBox> Boxes;
+	TArray<FDebugRenderSceneProxy::FSphere> Spheres;
+	TArray<FDebugRenderSceneProxy::FText3d> Texts;
+	FBox Bounds = FBox(ForceInit);
+
+	void Reset();
+	
+	void AddLine(const FVector& Start, const FVector& End, const FColor& Color, float Thickness = 0.f);
+	
+	/*Shaft & head as lines, the head sized like DrawDebugDirectionalArrow's ArrowSize, which the proxy's own arrows can't*/
+	void AddArrow(const FVector& Start, const FVector& End, const FColor& Color, float ArrowSize, float Thickness = 0.f);
+	void AddBox(const FVector& Center, const FVector& Extent, const FColor& Color);
+	void AddSphere(const FVector& Center, float Radius, const FColor& Color);
+	void AddText(const FVector& Location, const FString& Text, const FColor& Color);
+};
+
+/*
+ * Draws the results of every NavAware agent of the world through one scene proxy, labels go through its text batch.
+ * Shapes of an agent stay until the agent sends its next result,
+ * the proxy is recreated at most once per frame no matter how many agents changed in it
+ */
+UCLASS(ClassGroup = Debug)
+class AISENSINGEXTENTED_API UNavAwareDebugRenderComponent : public UDebugDrawComponent
+{
+	GENERATED_BODY()
+
+public:
+	UNavAwareDebugRenderComponent();
+
+	/*Replaces the shapes of given agent*/
+	void SetAgentShapes(const AActor* Agent, FNavAwareDebugShapes&& Shapes);
+	
+	void ClearAgent(const AActor* Agent);
+
+protected:
+#if NAVAWARE_WITH_DEBUG_DRAW
+	virtual FDebugRenderSceneProxy* CreateDebugSceneProxy() override;
+#endif
+	virtual FBoxSphereBounds CalcBounds(const FTransform& LocalToWorld) const override;
+
+private:
+	void OnShapesChanged();
+	
+	TMap<TWeakObjectPtr<const AActor>, FNavAwareDebugShapes> AgentShapes;
+};
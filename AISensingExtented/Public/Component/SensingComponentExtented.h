@@ -4,8 +4,88 @@
 
 #include "CoreMinimal.h"
 #include "Runtime/AIModule/Classes/Perception/PawnSensingComponent.h"
+#include "WorldCollision.h"
+#include "SensingLineOfSightCache.h"
 #include "SensingComponentExtented.generated.h"
 
+class ANavigationData;
+class USphereComponent;
+
+DECLARE_LOG_CATEGORY_EXTERN(SensingExtented, Log, All);
+
+/*
+ * How USensingComponentExtented answers line of sight
+ */
+UENUM(BlueprintType)
+enum class ESensingLineOfSightMode : uint8
+{
+    /*Controller's LineOfSightTo against full collision*/
+    Physics,
+    /*Raycast along the navmesh between both pawns' nav locations, pawns off the navmesh are never seen*/
+    NavMesh,
+    /*NavMesh, then a single visibility trace between the eyes only for what the navmesh let through*/
+    NavMeshThenPhysics,
+};
+
+/*
+ * What a USensingComponentExtented knows about one pawn it currently sees
+ */
+USTRUCT(BlueprintType)
+struct FSensedPawnState
+{
+	GENERATED_BODY()
+
+	/*Sense pass this pawn was last seen in, anything older than the current pass is unseen by the end of it*/
+	uint32 LastSeenPass = 0;
+
+	UPROPERTY(BlueprintReadOnly, Category= "State")
+	float FirstSeenTime = 0.f;
+	
+	UPROPERTY(BlueprintReadOnly, Category= "State")
+	float LastSeenTime = 0.f;
+
+	UPROPERTY(BlueprintReadOnly, Category= "State")
+	FVector LastKnownLocation = FVector::ZeroVector;
+};
+
+/*
+ * Filtered async line of sight to one pawn, flips only after LineOfSightHysteresis traces in a row disagree with it
+ */
+struct FLineOfSightState
+{
+	bool bHasLineOfSight = false;
+	bool bHasResult = false;
+	bool bTracePending = false;
+	uint8 DisagreeingTraces = 0;
+	
+	/*Sense pass that last wanted to know, states nobody asked for during a pass are dropped*/
+	uint32 LastSensePass = 0;
+
+	/*Sense pass that last asked for a trace, OnSeePawn goes out for it once that pass's traces are in*/
+	uint32 LastRequestPass = 0;
+};
+
+/*
+ * Async trace in flight
+ */
+struct FPendingLineOfSightTrace
+{
+	TWeakObjectPtr<APawn> Pawn;
+	FSensingLineOfSightKey Key;
+	bool bShared = false;
+};
+
+/*
+ * A pawn inside the sight volume of an event driven sensor
+ */
+struct FSensingCandidate
+{
+	FVector LastSensedLocation = FVector::ZeroVector;
+	double LastSensedTime = 0.0;
+	
+	/*Entered since the last pass*/
+	bool bEntered = true;
+};
 
 UCLASS(ClassGroup=(Custom), meta=(BlueprintSpawnableComponent))
 class AISENSINGEXTENTED_API USensingComponentExtented : public UPawnSensingComponent
@@ -18,6 +98,7 @@ public:
 
 protected:
 	virtual void BeginPlay() override;
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
 
 public:
 	virtual void TickComponent(float DeltaTime, ELevelTick TickType,
@@ -25,7 +106,37 @@ public:
 
 	
 protected:
+	/*Runs one sense pass over the candidate pawns, then unsees whatever wasn't refreshed during it*/
+	virtual void UpdateAISensing() override;
+	
 	virtual void SensePawn(APawn& Pawn) override;
+
+	/*Own timer is never set while the sensing scheduler drives this component*/
+	virtual void SetTimer(const float TimeDelay) override;
+
+public:
+	/*
+	 * One sensing pass, called by USensingSchedulerSubsystem. Returns the number of line of sight checks it did
+	 */
+	int32 RunSensingPass();
+
+	FORCEINLINE bool IsSensingEnabled() const { return bEnableSensingUpdates; }
+
+	/*Line of sight to given pawn as given mode answers it, synchronously*/
+	bool HasLineOfSightWithMode(const APawn& Pawn, ESensingLineOfSightMode Mode) const;
+
+	/*Sees any pawn right now*/
+	FORCEINLINE bool IsAlerted() const { return SeenPawns.Num() > 0; }
+	
+	UFUNCTION(BlueprintPure, Category= "AI|Components|PawnSensing")
+	bool IsPawnSeen(APawn* Pawn) const;
+
+	/*Returns false when given pawn isn't seen*/
+	UFUNCTION(BlueprintPure, Category= "AI|Components|PawnSensing")
+	bool GetSensedPawnState(APawn* Pawn, FSensedPawnState& OutState) const;
+	
+	UFUNCTION(BlueprintPure, Category= "AI|Components|PawnSensing")
+	TArray<APawn*> GetSeenPawns() const;
 	
 /**Extension thingy**/
 private:
@@ -33,16 +144,174 @@ private:
 protected:
 	
 	DECLARE_DYNAMIC_MULTICAST_DELEGATE_OneParam( FUnSeePawnDelegate, APawn*, Pawn );
+	DECLARE_DYNAMIC_MULTICAST_DELEGATE_TwoParams( FSightChangedDelegate, const TArray<APawn*>&, NewlySeenPawns, const TArray<APawn*>&, UnseenPawns );
 	
 	//Broadcast UnSeePawn delegate
 	void BroadCastUnseenPawn(APawn& Pawn);
 
-	//Array to store seen pawns
+	/*Drops given pawn from SeenPawns, broadcasts UnSeePawn when it was seen*/
+	void ForgetPawn(APawn& Pawn);
+
+	/*Broadcasts UnSeePawn for every pawn not seen during the current pass, drops destroyed ones*/
+	void SweepUnseenPawns();
+
+	/*Fires OnSightChanged with the changes gathered during the pass, if there were any*/
+	void BroadcastSightChanges();
+
+	/*
+	 * Sight events of a pass whose line of sight is resolved: OnSeePawn for every pawn an async trace found visible
+	 * during it unless batched, then OnSightChanged. Runs at the end of the pass, or when its last async trace is in
+	 */
+	void FinishSensePass();
+
+	/*Adds given pawn to SeenPawns or refreshes it, broadcasts OnSeePawn unless batched or told to leave it to FinishSensePass*/
+	void MarkPawnSeen(APawn& Pawn, bool bBroadcastSeen = true);
+
+	/*
+	 * Async line of sight: queues a trace to given pawn and returns the filtered result of the earlier ones,
+	 * the sight change is applied once the trace is resolved next frame
+	 */
+	bool RequestLineOfSight(APawn& Pawn);
+
+	void OnLineOfSightTraceDone(const FTraceHandle& Handle, FTraceDatum& Datum);
+
+	/*Feeds one raw result into the hysteresis of given state, returns the filtered line of sight*/
+	bool FilterLineOfSight(FLineOfSightState& State, bool bRawLineOfSight) const;
+
+	/*
+	 * Synchronous line of sight of LineOfSightMode, answered from the shared cache when another sensor asked the same recently
+	 */
+	bool HasSharedLineOfSightTo(const APawn& Pawn);
+
+	/*Cache of the world's sensing scheduler, nullptr when the cache is off or there is no scheduler*/
+	FSensingLineOfSightCache* GetLineOfSightCache() const;
+	
+	bool HasNavMeshLineOfSightTo(const APawn& Pawn) const;
+	bool HasTraceLineOfSightTo(const APawn& Pawn) const;
+	FCollisionQueryParams MakeLineOfSightParams(const APawn& Pawn) const;
+	const ANavigationData* GetSensingNavData() const;
+
+	/*Event driven mode: spawns the sight volume and takes in whatever overlaps it already*/
+	void CreateSightVolume();
+
+	/*
+	 * Event driven mode: fills CandidatePawns with candidates that entered, moved or went stale since they were last sensed,
+	 * the others keep their sight state through this pass
+	 */
+	void CollectDueCandidates();
+
+	UFUNCTION()
+	void OnSightVolumeBeginOverlap(UPrimitiveComponent* OverlappedComponent, AActor* OtherActor, UPrimitiveComponent* OtherComp, int32 OtherBodyIndex, bool bFromSweep, const FHitResult& SweepResult);
+	
+	UFUNCTION()
+	void OnSightVolumeEndOverlap(UPrimitiveComponent* OverlappedComponent, AActor* OtherActor, UPrimitiveComponent* OtherComp, int32 OtherBodyIndex);
+
+	//Seen pawns, keyed by weak handle so destroyed pawns don't linger
 	UPROPERTY(VisibleInstanceOnly, Category= "State")
-	TArray<APawn*> ListOfSeenPawn;
+	TMap<TWeakObjectPtr<APawn>, FSensedPawnState> SeenPawns;
+
+	//Increases once per UpdateAISensing
+	uint32 SensePass = 0;
+
+	//Line of sight checks of the running pass
+	int32 NumLineOfSightChecks = 0;
+
+	//Registered with the world's USensingSchedulerSubsystem
+	bool bScheduled = false;
+
+	//Reused by every pass
+	TArray<APawn*> CandidatePawns;
+
+	//Async line of sight
+	TMap<TWeakObjectPtr<APawn>, FLineOfSightState> LineOfSightStates;
+	TMap<uint32, FPendingLineOfSightTrace> PendingTraces;
+	uint32 NextTraceTicket = 0;
+	FTraceDelegate LineOfSightTraceDelegate;
+
+	//Sight events of the last pass wait for its async traces
+	bool bSenseEventsDeferred = false;
+
+	//Found on first navmesh check
+	mutable TWeakObjectPtr<const ANavigationData> SensingNavData;
+
+	//Event driven mode
+	UPROPERTY(Transient)
+	TObjectPtr<USphereComponent> SightVolume;
+	TMap<TWeakObjectPtr<APawn>, FSensingCandidate> Candidates;
+	FVector LastSensorLocation = FVector::ZeroVector;
+	FRotator LastSensorRotation = FRotator::ZeroRotator;
+
+	//Changes of the running pass, only filled in batched mode
+	TArray<APawn*> PendingNewlySeen;
+	TArray<APawn*> PendingUnseen;
 
 public:
 	/** Delegate to execute when we unsee a Pawn (Pawn is seen last frame). */
 	UPROPERTY(BlueprintAssignable)
 	FUnSeePawnDelegate UnSeePawn;
+
+	/*
+	 * Batched mode: OnSeePawn and UnSeePawn are not broadcast,
+	 * instead OnSightChanged fires once at the end of a sensing pass with the pawns that entered and left sight during it
+	 */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category= "AI")
+	bool bBatchSightEvents = false;
+
+	/*
+	 * Let the world's USensingSchedulerSubsystem run sensing passes instead of an own timer,
+	 * SensingInterval is then scaled by distance to the player and alert state. Read at begin play.
+	 * With bHearNoises the scaled interval never exceeds HearingMaxSoundAge, so noises between passes are still heard
+	 */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category= "AI")
+	bool bUseSensingScheduler = false;
+
+	/*
+	 * Sense only pawns in the cells of the shared pawn grid within max(SightRadius, HearingThreshold, LOSHearingThreshold),
+	 * instead of every pawn of the world. Pawns that made a remote noise, or a local one louder than 1,
+	 * within HearingMaxSoundAge are sensed wherever they stand
+	 */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category= "AI")
+	bool bUsePawnGrid = false;
+
+	/*
+	 * Line of sight checks of a pass are queued as async visibility traces instead of run one by one,
+	 * pawns are seen/unseen when the results come in next frame.
+	 * OnSeePawn and OnSightChanged of a pass then fire once all of its traces are in, still once per pass
+	 */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category= "AI")
+	bool bAsyncLineOfSight = false;
+
+	/*
+	 * NavMesh modes are much cheaper than physics, but only see pawns standing on walkable ground.
+	 * Falls back to Physics when the world has no navmesh. "Sensing.BenchmarkLineOfSight" compares the modes in a running world
+	 */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category= "AI")
+	ESensingLineOfSightMode LineOfSightMode = ESensingLineOfSightMode::Physics;
+
+	/*Share line of sight answers with sensors asking about the same target from about the same place, see FSensingLineOfSightCache*/
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category= "AI")
+	bool bUseLineOfSightCache = true;
+
+	/*
+	 * Keep a sphere of max(SightRadius, HearingThreshold, LOSHearingThreshold) around the owner and only sense pawns
+	 * that entered it, moved further than CandidateMoveThreshold, made a noise or weren't sensed for CandidateStaleTime.
+	 * Everything is sensed again when the sensor itself moves or turns. Read at begin play.
+	 * With bHearNoises, pawns outside the sphere that made a remote noise, or a local one louder than 1, are sensed as well
+	 */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category= "AI")
+	bool bEventDrivenSensing = false;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category= "AI", meta=(EditCondition = "bEventDrivenSensing"))
+	float CandidateMoveThreshold = 50.f;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category= "AI", meta=(EditCondition = "bEventDrivenSensing"))
+	float CandidateStaleTime = 1.f;
+
+	/*Async traces in a row that must disagree with the current line of sight before it flips*/
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category= "AI", meta=(ClampMin = "1", EditCondition = "bAsyncLineOfSight"))
+	int32 LineOfSightHysteresis = 2;
+
+	/** Delegate to execute once per sensing pass in batched mode, when any pawn was newly seen or unseen. */
+	UPROPERTY(BlueprintAssignable)
+	FSightChangedDelegate OnSightChanged;
 };
@@ -0,0 +1,155 @@
+﻿#pragma once
+
+#include "CoreMinimal.h"
+#include "Actor/NavAwareEnhancedBase.h"
+
+class IMappedFileHandle;
+class IMappedFileRegion;
+
+/*
+ * Layout of a baked awareness file (*.navaware), everything is plain data and indices, no pointers:
+ * [Header][Cells...][Edges...][Corners...][Entries...]
+ * Cells are sorted by their key, so a lookup is a binary search straight on the mapped memory.
+ * Edge/corner indices are local to their cell, and so are positions: the bake origin is stored relative to the cell's
+ * min corner, everything else relative to the bake origin, which keeps float precise on large maps. Load checks every cell's ranges and indices once,
+ * a file failing that is not used at all.
+ *
+ * Files live in Content/NavAware/<MapName>.navaware, add "NavAware" to DirectoriesToAlwaysStageAsNonUFS
+ * so they stay outside of the pak file and can be memory-mapped in packaged builds
+ */
+static constexpr uint32 NavAwareBakeMagic = 0x4E415742;	//'NAWB'
+static constexpr uint32 NavAwareBakeVersion = 4;
+
+struct FNavAwareBakeHeader
+{
+	uint32 Magic = NavAwareBakeMagic;
+	uint32 Version = NavAwareBakeVersion;
+	float CellSize = 0.f;
+	float Radius = 0.f;
+	uint32 SettingsHash = 0;
+	uint32 NumCells = 0;
+	uint32 NumEdges = 0;
+	uint32 NumCorners = 0;
+	uint32 NumEntries = 0;
+	uint32 Padding = 0;
+};
+
+struct FNavAwareBakedCell
+{
+	FIntVector Key;
+	
+	/*Where this cell's result was queried from, the first poly center found in the cell, relative to Key * CellSize*/
+	FVector3f OriginInCell;
+	uint32 FirstEdge;
+	uint32 NumEdges;
+	uint32 FirstCorner;
+	uint32 NumCorners;
+	uint32 FirstEntry;
+	uint32 NumEntries;
+};
+
+struct FNavAwareBakedEdge
+{
+	FVector3f Start;
+	FVector3f End;
+	int32 PrevEdge;
+	int32 NextEdge;
+	int32 LineID;
+	uint8 Type;
+	uint8 Padding[3];
+};
+
+struct FNavAwareBakedCorner
+{
+	int32 CornerStart;
+	int32 CornerEnd;
+	uint32 CornerID;
+};
+
+struct FNavAwareBakedEntry
+{
+	int32 CornerID;
+	int32 EdgeA;
+	int32 EdgeB;
+	FVector3f Start;
+	FVector3f End;
+	FVector3f Location;
+	float Width;
+};
+
+/*
+ * Read side, maps a baked file and copies cells back into FNavAwareResult
+ */
+class AISENSINGEXTENTED_API FNavAwareBakedData
+{
+public:
+	FNavAwareBakedData();
+	~FNavAwareBakedData();
+
+	static FString GetBakedDataPath(const UWorld* World);
+	
+	static FORCEINLINE FIntVector GetCellKey(const FVector& Location, float CellSize)
+	{
+		return FIntVector(
+			FMath::FloorToInt(Location.X / CellSize),
+			FMath::FloorToInt(Location.Y / CellSize),
+			FMath::FloorToInt(Location.Z / CellSize));
+	}
+
+	static FORCEINLINE FVector GetCellMin(const FIntVector& Key, float CellSize)
+	{
+		return FVector(Key) * CellSize;
+	}
+
+	bool Load(const FString& Path);
+	void Unload();
+
+	FORCEINLINE bool IsLoaded() const { return Header != nullptr; }
+	FORCEINLINE const FNavAwareBakeHeader* GetHeader() const { return Header; }
+
+	/*Index below the header's NumCells*/
+	FORCEINLINE const FNavAwareBakedCell& GetCell(uint32 Index) const { return Cells[Index]; }
+	FORCEINLINE FVector GetCellOrigin(const FNavAwareBakedCell& Cell) const { return GetCellMin(Cell.Key, Header->CellSize) + FVector(Cell.OriginInCell); }
+
+	/*
+	 * Returns false if Origin's cell wasn't baked, or was baked from further away than MaxOriginDistance
+	 */
+	bool FindResult(const FVector& Origin, float MaxOriginDistance, FNavAwareResult& OutResult) const;
+
+private:
+	bool BindView(const uint8* Data, int64 Size);
+	
+	TUniquePtr<IMappedFileHandle> MappedHandle;
+	TUniquePtr<IMappedFileRegion> MappedRegion;
+
+	/*Used only when the platform can't map files*/
+	TArray<uint8> LoadedBytes;
+
+	const FNavAwareBakeHeader* Header = nullptr;
+	const FNavAwareBakedCell* Cells = nullptr;
+	const FNavAwareBakedEdge* Edges = nullptr;
+	const FNavAwareBakedCorner* Corners = nullptr;
+	const FNavAwareBakedEntry* Entries = nullptr;
+};
+
+/*
+ * Write side, collects one result per cell and flattens them into the file layout
+ */
+class AISENSINGEXTENTED_API FNavAwareBakedDataWriter
+{
+public:
+	FNavAwareBakedDataWriter(float InCellSize, float InRadius, uint32 InSettingsHash);
+
+	void AddCell(const FIntVector& Key, const FVector& Origin, const FNavAwareResult& Result);
+
+	bool Save(const FString& Path);
+
+	FORCEINLINE int32 GetNumCells() const { return Cells.Num(); }
+
+private:
+	FNavAwareBakeHeader Header;
+	TArray<FNavAwareBakedCell> Cells;
+	TArray<FNavAwareBakedEdge> Edges;
+	TArray<FNavAwareBakedCorner> Corners;
+	TArray<FNavAwareBakedEntry> Entries;
+};
@@ -0,0 +1,41 @@
+﻿#pragma once
+
+#include "CoreMinimal.h"
+#include "NavMesh/RecastNavMesh.h"
+
+#if WITH_EDITOR
+
+/*
+ * Wall edge sets to feed the awareness pipeline without a navmesh.
+ * Recorded ones are FindEdges results saved as text, one "StartX StartY StartZ EndX EndY EndZ" per line,
+ * synthetic ones are generated at a requested edge count, every wall keeps the walkable side on its right (+Y of a wall along +X)
+ */
+struct AISENSINGEXTENTED_API FNavAwareEdgeFixture
+{
+	FString Name;
+	TArray<FNavigationWallEdge> Edges;
+
+	static FString GetFixtureDir();
+	
+	static bool Save(const FString& Path, const TArray<FNavigationWallEdge>& InEdges);
+	static bool Load(const FString& Path, FNavAwareEdgeFixture& OutFixture);
+
+	/*Two parallel walls*/
+	static FNavAwareEdgeFixture MakeCorridor(int32 NumEdges, int32 Seed);
+	
+	/*Four L shaped walls around a crossing of two corridors*/
+	static FNavAwareEdgeFixture MakeCrossRoads(int32 NumEdges, int32 Seed);
+	
+	/*Closed rectangular loops side by side*/
+	static FNavAwareEdgeFixture MakeRoomLoops(int32 NumEdges, int32 Seed);
+	
+	/*Two concentric arcs with jittered vertices*/
+	static FNavAwareEdgeFixture MakeNoisyCurve(int32 NumEdges, int32 Seed);
+
+	/*
+	 * Crossroads plus two walls in line far away from it. After closes the gap between those walls, merging their lines,
+	 * which renumbers the lines coming after them while nothing changes near the crossing
+	 */
+	static void MakeDistantMerge(int32 Seed, FNavAwareEdgeFixture& OutBefore, FNavAwareEdgeFixture& OutAfter);
+};
+#endif
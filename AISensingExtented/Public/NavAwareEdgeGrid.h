@@ -0,0 +1,50 @@
+﻿#pragma once
+
+#include "CoreMinimal.h"
+#include "NavAwareEdgeStore.h"
+
+/*
+ * Uniform 2D grid over the edges of one query, built once and then asked
+ * "nearest edge of every other line" for each edge that takes steps.
+ * Every edge is registered in each cell its bounding box overlaps
+ */
+class AISENSINGEXTENTED_API FNavAwareEdgeGrid
+{
+public:
+	void Build(const FNavAwareEdgeStore& InEdges, float InCellSize);
+
+	/*
+	 * For every line other than the given edge's, the edge with the nearest middle point,
+	 * only edges whose bounding box is within MaxDistance of the given edge's are considered.
+	 * Output is sorted by distance
+	 */
+	void FindNearestEdgePerLine(int32 EdgeIndex, float MaxDistance, TArray<int32>& OutEdges) const;
+
+private:
+	struct FCellItem
+	{
+		int32 Edge;
+		int32 Next;
+	};
+
+	FORCEINLINE FIntPoint ToCell(float X, float Y) const
+	{
+		return FIntPoint(FMath::FloorToInt(X / CellSize), FMath::FloorToInt(Y / CellSize));
+	}
+
+	const FNavAwareEdgeStore* Edges = nullptr;
+	float CellSize = 100.f;
+
+	TMap<FIntPoint, int32> CellHeads;
+	TArray<FCellItem> CellItems;
+	TArray<FBox2f> EdgeBounds;
+	TArray<FVector3f> EdgeMiddles;
+	int32 NumLines = 0;
+
+	/*Scratch of queries, stamps avoid clearing per query*/
+	mutable TArray<uint32> EdgeStamps;
+	mutable TArray<uint32> LineStamps;
+	mutable TArray<int32> BestEdgeOfLine;
+	mutable TArray<float> BestDistOfLine;
+	mutable uint32 QueryStamp = 0;
+};
@@ -0,0 +1,92 @@
+﻿#pragma once
+
+#include "CoreMinimal.h"
+#include "Actor/NavAwareEnhancedBase.h"
+
+/*
+ * Query-local edge storage of the awareness pipeline, one column per field so every stage walks only what it reads.
+ * Edges are addressed by index, which is also their EdgeID, and link to each other by index, so nothing dangles
+ * when the columns grow. Turned into the Blueprint facing TArray<FNavPoint> through ToView once the pipeline is done.
+ * Starts/Ends are relative to Origin, the query origin, so float keeps sub-unit precision far from the world origin
+ */
+struct AISENSINGEXTENTED_API FNavAwareEdgeStore
+{
+	FVector Origin = FVector::ZeroVector;
+	TArray<FVector3f> Starts;
+	TArray<FVector3f> Ends;
+	TArray<EWallType> Types;
+	TArray<int32> LineIDs;
+	TArray<int32> PrevEdges;
+	TArray<int32> NextEdges;
+
+	FORCEINLINE int32 Num() const { return Starts.Num(); }
+
+	FORCEINLINE void Reset(const FVector& InOrigin = FVector::ZeroVector)
+	{
+		Origin = InOrigin;
+		Starts.Reset();
+		Ends.Reset();
+		Types.Reset();
+		LineIDs.Reset();
+		PrevEdges.Reset();
+		NextEdges.Reset();
+	}
+
+	FORCEINLINE void Reserve(int32 Number)
+	{
+		Starts.Reserve(Number);
+		Ends.Reserve(Number);
+		Types.Reserve(Number);
+		LineIDs.Reserve(Number);
+		PrevEdges.Reserve(Number);
+		NextEdges.Reserve(Number);
+	}
+
+	FORCEINLINE FVector3f ToLocal(const FVector& Point) const { return FVector3f(Point - Origin); }
+	FORCEINLINE FVector GetStart(int32 Edge) const { return Origin + FVector(Starts[Edge]); }
+	FORCEINLINE FVector GetEnd(int32 Edge) const { return Origin + FVector(Ends[Edge]); }
+
+	/*Start & End local, returns index of the new edge, it starts as an unlinked wall*/
+	FORCEINLINE int32 Add(const FVector3f& Start, const FVector3f& End, int32 LineID)
+	{
+		Starts.Add(Start);
+		Ends.Add(End);
+		Types.Add(EWallType::Wall);
+		LineIDs.Add(LineID);
+		PrevEdges.Add(INDEX_NONE);
+		return NextEdges.Add(INDEX_NONE);
+	}
+
+	FORCEINLINE FVector3f GetDirection(int32 Edge) const { return Ends[Edge] - Starts[Edge]; }
+	FORCEINLINE FVector3f GetMiddle(int32 Edge) const { return (Starts[Edge] + Ends[Edge]) / 2; }
+	
+	FORCEINLINE FBox2f GetBounds2D(int32 Edge) const
+	{
+		FBox2f Bounds(ForceInit);
+		Bounds += FVector2f(Starts[Edge]);
+		Bounds += FVector2f(Ends[Edge]);
+		return Bounds;
+	}
+	
+	/*
+	 * Wall chains of the store, single edges under LineID 0 aren't one.
+	 * Edges of a line are contiguous once sorted, so IDs are counted by their runs, whatever their values
+	 */
+	FORCEINLINE int32 NumLines() const
+	{
+		int32 Lines = 0;
+		for (int32 i = 0; i < LineIDs.Num(); i++)
+		{
+			Lines += LineIDs[i] != 0 && (i == 0 || LineIDs[i] != LineIDs[i - 1]);
+		}
+		return Lines;
+	}
+
+	FORCEINLINE bool HasPrev(int32 Edge) const { return PrevEdges[Edge] != INDEX_NONE; }
+	FORCEINLINE bool HasNext(int32 Edge) const { return NextEdges[Edge] != INDEX_NONE; }
+
+	/*
+	 * Fills the Blueprint facing edges, one FNavPoint per edge in the same order
+	 */
+	void ToView(TArray<FNavPoint>& OutEdges) const;
+};
@@ -0,0 +1,76 @@
+﻿#pragma once
+
+#include "CoreMinimal.h"
+#include "NavAwareEdgeStore.h"
+
+/*
+ * What one agent's last full query left behind, the next query of the same agent is diffed against it.
+ * Only touched by RunPipeline under the owner's IncrementalSection, any mismatch of radius, settings or navmesh serial turns it into a full run
+ */
+struct FNavAwareIncrementalState
+{
+	/*Classified edges and corners of the last query*/
+	FNavAwareEdgeStore Edges;
+	TArray<FCorner> Corners;
+
+	/*Entries found from every corner before being deduplicated, same order as Corners*/
+	TArray<TArray<FEntry>> CornerEntries;
+
+	float Radius = 0.f;
+	uint32 SettingsHash = 0;
+	uint32 NavSerial = 0;
+	bool bValid = false;
+
+	FORCEINLINE bool Matches(float InRadius, uint32 InSettingsHash, uint32 InNavSerial) const
+	{
+		return bValid && Radius == InRadius && SettingsHash == InSettingsHash && NavSerial == InNavSerial;
+	}
+
+	FORCEINLINE void Invalidate()
+	{
+		bValid = false;
+		Edges.Reset();
+		Corners.Reset();
+		CornerEntries.Reset();
+	}
+};
+
+/*
+ * Difference between the last and the new edge set of an agent.
+ * Edges are matched by their quantized endpoints; a line counts as unchanged only if all of its edges,
+ * in the same order and from the same head, match one old line of the same length, so its classification can be copied over
+ */
+class AISENSINGEXTENTED_API FNavAwareEdgeDiff
+{
+public:
+	void Build(const FNavAwareEdgeStore& OldEdges, const FNavAwareEdgeStore& NewEdges, float Quantum);
+
+	/*Old edge matching given new edge, INDEX_NONE for edges of changed lines and new edges*/
+	FORCEINLINE int32 GetOldEdge(int32 NewEdge) const { return NewToOld[NewEdge]; }
+	
+	/*New edge matching given old edge, INDEX_NONE if it was removed or its line changed*/
+	FORCEINLINE int32 GetNewEdge(int32 OldEdge) const { return OldToNew.IsValidIndex(OldEdge) ? OldToNew[OldEdge] : INDEX_NONE; }
+
+	/*Old LineID of given new line, INDEX_NONE for changed lines, single edges keep LineID '0'*/
+	FORCEINLINE int32 GetOldLine(int32 NewLine) const { return NewLineToOld.IsValidIndex(NewLine) ? NewLineToOld[NewLine] : INDEX_NONE; }
+
+	/*Indexed by new LineID, LineID '0' is never dirty since single edges are not classified*/
+	FORCEINLINE const TBitArray<>& GetDirtyLines() const { return DirtyLines; }
+	FORCEINLINE bool IsLineDirty(int32 LineID) const { return DirtyLines[LineID]; }
+
+	FORCEINLINE int32 GetNumChangedEdges() const { return ChangedBounds.Num(); }
+
+	/*
+	 * True if given bounds, relative to the new edges' origin, come within Distance of an added or removed edge
+	 */
+	bool IsNearChange(const FBox2f& Bounds, float Distance) const;
+
+private:
+	TArray<int32> NewToOld;
+	TArray<int32> OldToNew;
+	TArray<int32> NewLineToOld;
+	TBitArray<> DirtyLines;
+
+	/*Bounds of every added edge and every removed one, relative to the new edges' origin*/
+	TArray<FBox2f> ChangedBounds;
+};
@@ -0,0 +1,41 @@
+﻿#pragma once
+
+#include "CoreMinimal.h"
+#include "Stats/Stats.h"
+#include "ProfilingDebugging/CpuProfilerTrace.h"
+
+/*
+ * "stat NavAware" shows one cycle counter per pipeline stage and what the queries went through.
+ * "(per frame)" counters add up every query of the frame, "(last query)" ones hold the figures of the last query that finished
+ */
+DECLARE_STATS_GROUP(TEXT("NavAware"), STATGROUP_NavAware, STATCAT_Advanced);
+
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Pipeline"), STAT_NavAware_Pipeline, STATGROUP_NavAware, AISENSINGEXTENTED_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("FindEdges"), STAT_NavAware_FindEdges, STATGROUP_NavAware, AISENSINGEXTENTED_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("GatherEdgesWithSorting"), STAT_NavAware_GatherEdgesWithSorting, STATGROUP_NavAware, AISENSINGEXTENTED_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("EdgeLinker"), STAT_NavAware_EdgeLinker, STATGROUP_NavAware, AISENSINGEXTENTED_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("EdgeDiff"), STAT_NavAware_EdgeDiff, STATGROUP_NavAware, AISENSINGEXTENTED_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("MarkCorner"), STAT_NavAware_MarkCorner, STATGROUP_NavAware, AISENSINGEXTENTED_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("FilterOnlyInnerEdge"), STAT_NavAware_FilterOnlyInnerEdge, STATGROUP_NavAware, AISENSINGEXTENTED_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("MarkEntryEdges"), STAT_NavAware_MarkEntryEdges, STATGROUP_NavAware, AISENSINGEXTENTED_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("MakeCornerArray"), STAT_NavAware_MakeCornerArray, STATGROUP_NavAware, AISENSINGEXTENTED_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("TakeSteps"), STAT_NavAware_TakeSteps, STATGROUP_NavAware, AISENSINGEXTENTED_API);
+
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Queries (per frame)"), STAT_NavAware_Queries, STATGROUP_NavAware, AISENSINGEXTENTED_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Edges (per frame)"), STAT_NavAware_Edges, STATGROUP_NavAware, AISENSINGEXTENTED_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Lines (per frame)"), STAT_NavAware_Lines, STATGROUP_NavAware, AISENSINGEXTENTED_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Corners (per frame)"), STAT_NavAware_Corners, STATGROUP_NavAware, AISENSINGEXTENTED_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Entries (per frame)"), STAT_NavAware_Entries, STATGROUP_NavAware, AISENSINGEXTENTED_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("FindNearestPoly calls (per frame)"), STAT_NavAware_FindNearestPolyCalls, STATGROUP_NavAware, AISENSINGEXTENTED_API);
+
+DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(TEXT("Edges (last query)"), STAT_NavAware_QueryEdges, STATGROUP_NavAware, AISENSINGEXTENTED_API);
+DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(TEXT("Lines (last query)"), STAT_NavAware_QueryLines, STATGROUP_NavAware, AISENSINGEXTENTED_API);
+DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(TEXT("Corners (last query)"), STAT_NavAware_QueryCorners, STATGROUP_NavAware, AISENSINGEXTENTED_API);
+DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(TEXT("Entries (last query)"), STAT_NavAware_QueryEntries, STATGROUP_NavAware, AISENSINGEXTENTED_API);
+
+/*
+ * Stat cycle counter and Insights cpu event of one stage, under the same name
+ */
+#define NAVAWARE_SCOPE(Stage) \
+	SCOPE_CYCLE_COUNTER(STAT_NavAware_##Stage); \
+	TRACE_CPUPROFILER_EVENT_SCOPE(NavAware_##Stage)
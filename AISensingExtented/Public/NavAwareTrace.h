@@ -0,0 +1,105 @@
+﻿#pragma once
+
+#include "CoreMinimal.h"
+
+/*
+ * Per query diagnostics of the awareness pipeline, compiled out of shipping builds.
+ * Stages record small binary events into the ring buffer of the query running on their thread,
+ * text is only made when a buffer is dumped
+ */
+#ifndef NAVAWARE_WITH_TRACE
+#define NAVAWARE_WITH_TRACE !UE_BUILD_SHIPPING
+#endif
+
+enum class ENavAwareTraceEvent : uint8
+{
+	EdgesSorted,		//A: FindEdges count, B: sorted edge count
+	CornersMarked,		//A: edge count, B: dirty line count, INDEX_NONE on a full pass
+	EntryEdgesMarked,	//A: edge count
+	StepsStarted,		//A: corner count
+	CornerReused,		//A: corner id
+	StepTarget,			//A: corner edge, B: target edge, Value: degree to the perpendicular line
+	StepsFinished,		//A: entry count
+};
+
+struct FNavAwareTraceRecord
+{
+	ENavAwareTraceEvent Event;
+	int32 A;
+	int32 B;
+	float Value;
+};
+
+#if NAVAWARE_WITH_TRACE
+
+class AISENSINGEXTENTED_API FNavAwareTraceBuffer
+{
+public:
+	/*Power of two, the oldest records are overwritten once a query goes past it*/
+	static constexpr int32 Capacity = 4096;
+	
+	void Reset()
+	{
+		Records.Reset();
+		NumRecorded = 0;
+	}
+	
+	FORCEINLINE void Record(ENavAwareTraceEvent Event, int32 A = 0, int32 B = 0, float Value = 0.f)
+	{
+		const FNavAwareTraceRecord NewRecord{Event, A, B, Value};
+		if (Records.Num() < Capacity)
+		{
+			Records.Add(NewRecord);
+		}
+		else
+		{
+			Records[NumRecorded & (Capacity - 1)] = NewRecord;
+		}
+		++NumRecorded;
+	}
+
+	int32 Num() const { return Records.Num(); }
+	uint32 GetNumDropped() const { return NumRecorded - Records.Num(); }
+
+	/*Formats every record still in the buffer to the NavAware log, oldest first*/
+	void Dump(const FString& Owner) const;
+
+	static FString Format(const FNavAwareTraceRecord& Record);
+
+	/*Buffer of the query running on this thread, nullptr outside of a FNavAwareTraceScope*/
+	static FNavAwareTraceBuffer* GetCurrent();
+
+private:
+	TArray<FNavAwareTraceRecord> Records;
+	uint32 NumRecorded = 0;
+
+	friend class FNavAwareTraceScope;
+};
+
+/*
+ * Points the stages on this thread at Buffer for one query
+ */
+class AISENSINGEXTENTED_API FNavAwareTraceScope
+{
+public:
+	explicit FNavAwareTraceScope(FNavAwareTraceBuffer& Buffer);
+	~FNavAwareTraceScope();
+
+private:
+	FNavAwareTraceBuffer* Previous;
+};
+
+#define NAVAWARE_TRACE(Event, ...) \
+	do \
+	{ \
+		if (FNavAwareTraceBuffer* NavAwareTraceBuffer = FNavAwareTraceBuffer::GetCurrent()) \
+		{ \
+			NavAwareTraceBuffer->Record(ENavAwareTraceEvent::Event, ##__VA_ARGS__); \
+		} \
+	} while (0)
+
+#else
+
+#define NAVAWARE_TRACE(Event, ...) do { } while (0)
+
+#endif
@@ -0,0 +1,30 @@
+﻿#pragma once
+
+#include "CoreMinimal.h"
+#include "Perception/AISenseConfig.h"
+#include "Perception/AISense_NavAwareness.h"
+#include "AISenseConfig_NavAwareness.generated.h"
+
+UCLASS(meta = (DisplayName = "AI NavAwareness config"))
+class AISENSINGEXTENTED_API UAISenseConfig_NavAwareness : public UAISenseConfig
+{
+	GENERATED_BODY()
+
+public:
+	UAISenseConfig_NavAwareness(const FObjectInitializer& ObjectInitializer = FObjectInitializer::Get());
+	
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category= "Sense", NoClear, config)
+	TSubclassOf<UAISense_NavAwareness> Implementation;
+
+	/*Corners and entries further than this from the listener are ignored*/
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category= "Sense", meta = (UIMin = 0.0, ClampMin = 0.0))
+	float Radius = 1000.f;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category= "Sense")
+	bool bDetectEntries = true;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category= "Sense")
+	bool bDetectCorners = true;
+
+	virtual TSubclassOf<UAISense> GetSenseImplementation() const override;
+};
@@ -0,0 +1,100 @@
+﻿#pragma once
+
+#include "CoreMinimal.h"
+#include "Perception/AISense.h"
+#include "AISense_NavAwareness.generated.h"
+
+class UAISenseConfig_NavAwareness;
+
+/*
+ * One corner or entry of a NavAware result, reduced to what a listener filters on
+ */
+USTRUCT(BlueprintType)
+struct AISENSINGEXTENTED_API FAINavAwarenessPoint
+{
+	GENERATED_BODY()
+
+	UPROPERTY(BlueprintReadWrite, Category= "Sense")
+	FVector Location = FVector::ZeroVector;
+
+	/*Width of the entry, 0 for corners*/
+	UPROPERTY(BlueprintReadWrite, Category= "Sense")
+	float Width = 0.f;
+
+	UPROPERTY(BlueprintReadWrite, Category= "Sense")
+	bool bIsEntry = false;
+};
+
+/*
+ * Every corner and entry one NavAware query found, reported once per result
+ */
+USTRUCT(BlueprintType)
+struct AISENSINGEXTENTED_API FAINavAwarenessEvent
+{
+	GENERATED_BODY()
+
+	typedef class UAISense_NavAwareness FSenseClass;
+
+	/*Actor that ran the query, the stimulus source listeners see. Its Corners/Entries hold the full result*/
+	UPROPERTY(BlueprintReadWrite, Category= "Sense")
+	TObjectPtr<AActor> Instigator = nullptr;
+
+	UPROPERTY(BlueprintReadWrite, Category= "Sense")
+	TArray<FAINavAwarenessPoint> Points;
+};
+
+/*
+ * Publishes NavAware corners and entries to AI perception.
+ * Results are reported by whoever ran the query, so one query serves every listener around it;
+ * each listener registers the nearest point in its radius from every reporter, entries before corners,
+ * and the perception system ages it out with the config's MaxAge
+ */
+UCLASS(ClassGroup= AI)
+class AISENSINGEXTENTED_API UAISense_NavAwareness : public UAISense
+{
+	GENERATED_BODY()
+
+public:
+	/*Stimulus tags, so listeners tell both kinds apart in OnTargetPerceptionUpdated*/
+	static const FName EntryTag;
+	static const FName CornerTag;
+	
+	UAISense_NavAwareness(const FObjectInitializer& ObjectInitializer = FObjectInitializer::Get());
+
+	void RegisterEvent(const FAINavAwarenessEvent& Event);
+	virtual void RegisterWrappedEvent(UAISenseEvent& PerceptionEvent) override;
+
+	UFUNCTION(BlueprintCallable, Category= "AI|Perception", meta = (WorldContext= "WorldContextObject"))
+	static void ReportNavAwarenessEvent(UObject* WorldContextObject, const FAINavAwarenessEvent& Event);
+
+	/*
+	 * Whether any perception component of any world is configured with this sense, reporters skip building events otherwise
+	 */
+	static FORCEINLINE bool HasListeners() { return NumListeners > 0; }
+
+protected:
+	virtual float Update() override;
+	virtual void BeginDestroy() override;
+
+	void OnNewListenerImpl(const FPerceptionListener& NewListener);
+	void OnListenerUpdateImpl(const FPerceptionListener& UpdatedListener);
+	void OnListenerRemovedImpl(const FPerceptionListener& RemovedListener);
+
+	struct FDigestedNavAwarenessProperties
+	{
+		float RadiusSq = 0.f;
+		bool bDetectEntries = true;
+		bool bDetectCorners = true;
+
+		FDigestedNavAwarenessProperties() = default;
+		explicit FDigestedNavAwarenessProperties(const UAISenseConfig_NavAwareness& SenseConfig);
+	};
+
+	TMap<FPerceptionListenerID, FDigestedNavAwarenessProperties> DigestedProperties;
+	
+	UPROPERTY()
+	TArray<FAINavAwarenessEvent> RegisteredEvents;
+
+	/*Digested listeners of every instance, game thread only*/
+	static int32 NumListeners;
+};
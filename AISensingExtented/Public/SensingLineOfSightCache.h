@@ -0,0 +1,65 @@
+﻿#pragma once
+
+#include "CoreMinimal.h"
+
+/*
+ * Identifies one line of sight answer: where it was asked from, where to, and how
+ */
+struct FSensingLineOfSightKey
+{
+	FIntVector ObserverCell = FIntVector::ZeroValue;
+	FIntVector TargetCell = FIntVector::ZeroValue;
+	uint8 Mode = 0;
+
+	FORCEINLINE bool operator==(const FSensingLineOfSightKey& Other) const
+	{
+		return ObserverCell == Other.ObserverCell && TargetCell == Other.TargetCell && Mode == Other.Mode;
+	}
+
+	friend FORCEINLINE uint32 GetTypeHash(const FSensingLineOfSightKey& Key)
+	{
+		return HashCombine(HashCombine(GetTypeHash(Key.ObserverCell), GetTypeHash(Key.TargetCell)), Key.Mode);
+	}
+};
+
+/*
+ * Line of sight answers shared by every sensor of a world for a short time,
+ * squad mates asking about the same target from about the same place within it get one trace between them.
+ * An actor moving into another cell asks with another key, so its old answers are never used for it again
+ */
+class AISENSINGEXTENTED_API FSensingLineOfSightCache
+{
+public:
+	void Configure(float InCellSize, float InTimeToLive);
+
+	FSensingLineOfSightKey MakeKey(const FVector& ObserverLocation, const FVector& TargetLocation, uint8 Mode) const;
+
+	/*
+	 * Returns false on a miss, or when the answer is older than the time to live
+	 */
+	bool Find(const FSensingLineOfSightKey& Key, double Now, bool& bOutHasLineOfSight) const;
+
+	void Store(const FSensingLineOfSightKey& Key, double Now, bool bHasLineOfSight);
+
+	/*Drops every expired answer*/
+	void Purge(double Now);
+
+	FORCEINLINE int32 Num() const { return Entries.Num(); }
+	FORCEINLINE float GetTimeToLive() const { return TimeToLive; }
+
+private:
+	struct FEntry
+	{
+		double Time;
+		bool bHasLineOfSight;
+	};
+
+	FORCEINLINE FIntVector ToCell(const FVector& Location) const
+	{
+		return FIntVector(FMath::FloorToInt(Location.X / CellSize), FMath::FloorToInt(Location.Y / CellSize), FMath::FloorToInt(Location.Z / CellSize));
+	}
+
+	TMap<FSensingLineOfSightKey, FEntry> Entries;
+	float CellSize = 100.f;
+	float TimeToLive = 0.2f;
+};
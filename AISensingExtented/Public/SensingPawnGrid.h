@@ -0,0 +1,51 @@
+﻿#pragma once
+
+#include "CoreMinimal.h"
+
+class APawn;
+
+/*
+ * Uniform 2D grid over every pawn of a world, rebuilt at most once per frame.
+ * Sensors ask it for the pawns around them instead of visiting every pawn of the world
+ */
+class AISENSINGEXTENTED_API FSensingPawnGrid
+{
+public:
+	void Build(UWorld* World, float InCellSize);
+
+	/*
+	 * Pawns standing in any cell the given circle overlaps, as of the last build.
+	 * Not filtered by distance, the sensing checks do that anyway
+	 */
+	void FindPawnsInCells(const FVector& Center, float Radius, TArray<APawn*>& OutPawns) const;
+
+	/*
+	 * Adds pawns that made a noise after SinceTime which may be heard from outside the cells of a query, and aren't in OutPawns yet.
+	 * A remote noise is heard at its own location, which can be far from its instigator's cell;
+	 * a local noise louder than 1 is heard further than the hearing thresholds a query radius is made of
+	 */
+	void AddRecentNoiseMakers(double SinceTime, TArray<APawn*>& OutPawns) const;
+
+	FORCEINLINE int32 Num() const { return Pawns.Num(); }
+
+private:
+	struct FCellItem
+	{
+		int32 Pawn;
+		int32 Next;
+	};
+
+	FORCEINLINE FIntPoint ToCell(double X, double Y) const
+	{
+		return FIntPoint(FMath::FloorToInt(X / CellSize), FMath::FloorToInt(Y / CellSize));
+	}
+
+	float CellSize = 1000.f;
+
+	TMap<FIntPoint, int32> CellHeads;
+	TArray<FCellItem> CellItems;
+	TArray<TWeakObjectPtr<APawn>> Pawns;
+
+	/*Indices into Pawns of those with a noise emitter*/
+	TArray<int32> NoiseMakers;
+};
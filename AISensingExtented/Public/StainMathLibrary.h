@@ -11,6 +11,31 @@ static FORCEINLINE float XYDegrees(FVector const& A, FVector const& B)
 		FMath::Acos(FVector::DotProduct(FVector(ANormal.X, ANormal.Y, 0.f), FVector(BNormal.X, BNormal.Y, 0.f)))) * FMath::Sign(FVector::CrossProduct(A, B).Z);
 }
 
+/*Turning of B from A on XY plane, kept as cosine and signed sine so no trig is needed to compare it*/
+struct FXYTurn
+{
+	float Cos = 1.f;
+	float Sin = 0.f;
+};
+
+/*Same angle as XYDegrees, without Acos*/
+static FORCEINLINE FXYTurn XYTurn(FVector const& A, FVector const& B)
+{
+	const FVector ANormal = A.GetSafeNormal();
+	const FVector BNormal = B.GetSafeNormal();
+	
+	FXYTurn Turn;
+	Turn.Cos = FMath::Clamp(static_cast<float>(ANormal.X * BNormal.X + ANormal.Y * BNormal.Y), -1.f, 1.f);
+	Turn.Sin = FMath::Sqrt(1.f - Turn.Cos * Turn.Cos) * FMath::Sign(static_cast<float>(A.X * B.Y - A.Y * B.X));
+	return Turn;
+}
+
+/*Sign of the Z of A x B, same sign XYDegrees(A, B) would have*/
+static FORCEINLINE float XYTurnSign(FVector const& A, FVector const& B)
+{
+	return FMath::Sign(static_cast<float>(A.X * B.Y - A.Y * B.X));
+}
+
 static FORCEINLINE FVector GetClosestPointFromLineSegment(const FVector& P, const FVector& LineStart, const FVector& LineEnd)
 {
 	const float x1 = LineStart.X;
@@ -48,29 +73,271 @@ static FORCEINLINE FVector GetClosestPointFromLineSegment(const FVector& P, cons
  */
 static FORCEINLINE std::tuple<FVector, FVector> GetShortestLineSegBetweenTwoLineSeg(const FVector& EdgeAStart, const FVector& EdgeAEnd, const FVector& EdgeBStart, const FVector& EdgeBEnd)
 {
-	const float LengthFromAStart = (GetClosestPointFromLineSegment(EdgeAStart, EdgeBStart, EdgeBEnd) - EdgeAStart).Length();
-	const float LengthFromAEnd = (GetClosestPointFromLineSegment(EdgeAEnd, EdgeBStart, EdgeBEnd) - EdgeAEnd).Length();
-	const float LengthFromBStart = (GetClosestPointFromLineSegment(EdgeBStart, EdgeAStart, EdgeAEnd) - EdgeBStart).Length();
-	const float LengthFromBEnd = (GetClosestPointFromLineSegment(EdgeBEnd, EdgeAStart, EdgeAEnd) - EdgeBEnd).Length();
+	const FVector OnBFromAStart = GetClosestPointFromLineSegment(EdgeAStart, EdgeBStart, EdgeBEnd);
+	const FVector OnBFromAEnd = GetClosestPointFromLineSegment(EdgeAEnd, EdgeBStart, EdgeBEnd);
+	const FVector OnAFromBStart = GetClosestPointFromLineSegment(EdgeBStart, EdgeAStart, EdgeAEnd);
+	const FVector OnAFromBEnd = GetClosestPointFromLineSegment(EdgeBEnd, EdgeAStart, EdgeAEnd);
+	
+	const float LengthFromAStart = (OnBFromAStart - EdgeAStart).Length();
+	const float LengthFromAEnd = (OnBFromAEnd - EdgeAEnd).Length();
+	const float LengthFromBStart = (OnAFromBStart - EdgeBStart).Length();
+	const float LengthFromBEnd = (OnAFromBEnd - EdgeBEnd).Length();
 
 	const float minDist = FMath::Min(FMath::Min(LengthFromAStart, LengthFromAEnd), FMath::Min(LengthFromBStart, LengthFromBEnd));
 
 	if (minDist == LengthFromAStart)
 	{
-		return std::make_tuple(EdgeAStart, GetClosestPointFromLineSegment(EdgeAStart, EdgeBStart, EdgeBEnd));
+		return std::make_tuple(EdgeAStart, OnBFromAStart);
 	}
 	if (minDist == LengthFromAEnd)
 	{
-		return std::make_tuple(EdgeAEnd, GetClosestPointFromLineSegment(EdgeAEnd, EdgeBStart, EdgeBEnd));
+		return std::make_tuple(EdgeAEnd, OnBFromAEnd);
 	}
 	if (minDist == LengthFromBStart)
 	{
-		return std::make_tuple(GetClosestPointFromLineSegment(EdgeBStart, EdgeAStart, EdgeAEnd), EdgeBStart);
+		return std::make_tuple(OnAFromBStart, EdgeBStart);
 	}
 	if (minDist == LengthFromBEnd)
 	{
-		return std::make_tuple(GetClosestPointFromLineSegment(EdgeBEnd, EdgeAStart, EdgeAEnd), EdgeBEnd);
+		return std::make_tuple(OnAFromBEnd, EdgeBEnd);
 	}
 
 	return std::make_tuple(FVector::ZeroVector, FVector::ZeroVector);
-}
\ No newline at end of file
+}
+
+/*Line segments packed as structure of arrays, input of the batch kernels*/
+struct FSegmentSoA
+{
+	TArray<float> StartX, StartY, StartZ;
+	TArray<float> EndX, EndY, EndZ;
+
+	FORCEINLINE int32 Num() const { return StartX.Num(); }
+
+	FORCEINLINE void Reset()
+	{
+		StartX.Reset(); StartY.Reset(); StartZ.Reset();
+		EndX.Reset(); EndY.Reset(); EndZ.Reset();
+	}
+
+	FORCEINLINE void Add(const FVector& Start, const FVector& End)
+	{
+		StartX.Add(Start.X); StartY.Add(Start.Y); StartZ.Add(Start.Z);
+		EndX.Add(End.X); EndY.Add(End.Y); EndZ.Add(End.Z);
+	}
+
+	FORCEINLINE void Add(const FVector3f& Start, const FVector3f& End)
+	{
+		StartX.Add(Start.X); StartY.Add(Start.Y); StartZ.Add(Start.Z);
+		EndX.Add(End.X); EndY.Add(End.Y); EndZ.Add(End.Z);
+	}
+};
+
+/*Directions packed as structure of arrays, input of XYTurnBatch*/
+struct FDirectionSoA
+{
+	TArray<float> X, Y, Z;
+
+	FORCEINLINE int32 Num() const { return X.Num(); }
+
+	FORCEINLINE void SetNumUninitialized(int32 Number)
+	{
+		X.SetNumUninitialized(Number); Y.SetNumUninitialized(Number); Z.SetNumUninitialized(Number);
+	}
+
+	FORCEINLINE void Set(int32 Index, const FVector3f& Direction)
+	{
+		X[Index] = Direction.X; Y[Index] = Direction.Y; Z[Index] = Direction.Z;
+	}
+};
+
+/*Output of the batch kernels, one element per input segment*/
+struct FSegmentBatchResult
+{
+	TArray<FVector> PointsOnA;
+	TArray<FVector> PointsOnB;
+	TArray<float> DistSquared;
+};
+
+namespace StainMath
+{
+	/*Loads 4 lanes from Index, lanes past Num repeat the last element*/
+	static FORCEINLINE VectorRegister4Float LoadLanes(const TArray<float>& Array, int32 Index)
+	{
+		if (Index + 4 <= Array.Num())
+		{
+			return VectorLoad(Array.GetData() + Index);
+		}
+		
+		alignas(16) float Lanes[4];
+		for (int32 Lane = 0; Lane < 4; Lane++)
+		{
+			Lanes[Lane] = Array[FMath::Min(Index + Lane, Array.Num() - 1)];
+		}
+		return VectorLoadAligned(Lanes);
+	}
+
+	static FORCEINLINE VectorRegister4Float Dot3(
+		const VectorRegister4Float& AX, const VectorRegister4Float& AY, const VectorRegister4Float& AZ,
+		const VectorRegister4Float& BX, const VectorRegister4Float& BY, const VectorRegister4Float& BZ)
+	{
+		return VectorMultiplyAdd(AZ, BZ, VectorMultiplyAdd(AY, BY, VectorMultiply(AX, BX)));
+	}
+
+	/*Lane-wise GetClosestPointFromLineSegment*/
+	static FORCEINLINE void ClosestPointOnSegment4(
+		const VectorRegister4Float& PX, const VectorRegister4Float& PY, const VectorRegister4Float& PZ,
+		const VectorRegister4Float& SX, const VectorRegister4Float& SY, const VectorRegister4Float& SZ,
+		const VectorRegister4Float& EX, const VectorRegister4Float& EY, const VectorRegister4Float& EZ,
+		VectorRegister4Float& OutX, VectorRegister4Float& OutY, VectorRegister4Float& OutZ)
+	{
+		const VectorRegister4Float Zero = VectorZeroFloat();
+		const VectorRegister4Float One = VectorOneFloat();
+		
+		const VectorRegister4Float DX = VectorSubtract(EX, SX);
+		const VectorRegister4Float DY = VectorSubtract(EY, SY);
+		const VectorRegister4Float DZ = VectorSubtract(EZ, SZ);
+		
+		const VectorRegister4Float LSquared = Dot3(DX, DY, DZ, DX, DY, DZ);
+		const VectorRegister4Float Dot = Dot3(VectorSubtract(PX, SX), VectorSubtract(PY, SY), VectorSubtract(PZ, SZ), DX, DY, DZ);
+
+		//degenerated segment returns its start
+		const VectorRegister4Float IsDegenerated = VectorCompareEQ(LSquared, Zero);
+		const VectorRegister4Float SafeLSquared = VectorSelect(IsDegenerated, One, LSquared);
+		const VectorRegister4Float T = VectorSelect(IsDegenerated, Zero, VectorMin(VectorMax(VectorDivide(Dot, SafeLSquared), Zero), One));
+
+		OutX = VectorMultiplyAdd(DX, T, SX);
+		OutY = VectorMultiplyAdd(DY, T, SY);
+		OutZ = VectorMultiplyAdd(DZ, T, SZ);
+	}
+
+	/*Lane-wise 1 / length, zero where GetSafeNormal would return a zero vector*/
+	static FORCEINLINE VectorRegister4Float SafeInvLength4(const VectorRegister4Float& X, const VectorRegister4Float& Y, const VectorRegister4Float& Z)
+	{
+		const VectorRegister4Float SquareSum = Dot3(X, Y, Z, X, Y, Z);
+		const VectorRegister4Float IsValid = VectorCompareGE(SquareSum, VectorSetFloat1(UE_SMALL_NUMBER));
+		return VectorSelect(IsValid, VectorReciprocalSqrtAccurate(VectorSelect(IsValid, SquareSum, VectorOneFloat())), VectorZeroFloat());
+	}
+
+	static FORCEINLINE VectorRegister4Float DistSquared4(
+		const VectorRegister4Float& AX, const VectorRegister4Float& AY, const VectorRegister4Float& AZ,
+		const VectorRegister4Float& BX, const VectorRegister4Float& BY, const VectorRegister4Float& BZ)
+	{
+		const VectorRegister4Float DX = VectorSubtract(AX, BX);
+		const VectorRegister4Float DY = VectorSubtract(AY, BY);
+		const VectorRegister4Float DZ = VectorSubtract(AZ, BZ);
+		return Dot3(DX, DY, DZ, DX, DY, DZ);
+	}
+}
+
+/*Batched GetShortestLineSegBetweenTwoLineSeg: tests segment A against every segment of Segments, 4 lanes at a time.
+ *Same candidates and same tie order as the scalar version, computed in float
+ */
+static FORCEINLINE void GetShortestLineSegsToSegmentBatch(const FVector& EdgeAStart, const FVector& EdgeAEnd, const FSegmentSoA& Segments, FSegmentBatchResult& OutResult)
+{
+	using namespace StainMath;
+	
+	const int32 Num = Segments.Num();
+	OutResult.PointsOnA.SetNumUninitialized(Num);
+	OutResult.PointsOnB.SetNumUninitialized(Num);
+	OutResult.DistSquared.SetNumUninitialized(Num);
+	
+	const VectorRegister4Float A0X = VectorSetFloat1(static_cast<float>(EdgeAStart.X));
+	const VectorRegister4Float A0Y = VectorSetFloat1(static_cast<float>(EdgeAStart.Y));
+	const VectorRegister4Float A0Z = VectorSetFloat1(static_cast<float>(EdgeAStart.Z));
+	const VectorRegister4Float A1X = VectorSetFloat1(static_cast<float>(EdgeAEnd.X));
+	const VectorRegister4Float A1Y = VectorSetFloat1(static_cast<float>(EdgeAEnd.Y));
+	const VectorRegister4Float A1Z = VectorSetFloat1(static_cast<float>(EdgeAEnd.Z));
+
+	for (int32 Index = 0; Index < Num; Index += 4)
+	{
+		const VectorRegister4Float B0X = LoadLanes(Segments.StartX, Index);
+		const VectorRegister4Float B0Y = LoadLanes(Segments.StartY, Index);
+		const VectorRegister4Float B0Z = LoadLanes(Segments.StartZ, Index);
+		const VectorRegister4Float B1X = LoadLanes(Segments.EndX, Index);
+		const VectorRegister4Float B1Y = LoadLanes(Segments.EndY, Index);
+		const VectorRegister4Float B1Z = LoadLanes(Segments.EndZ, Index);
+
+		//A's ends onto B
+		VectorRegister4Float OnB0X, OnB0Y, OnB0Z, OnB1X, OnB1Y, OnB1Z;
+		ClosestPointOnSegment4(A0X, A0Y, A0Z, B0X, B0Y, B0Z, B1X, B1Y, B1Z, OnB0X, OnB0Y, OnB0Z);
+		ClosestPointOnSegment4(A1X, A1Y, A1Z, B0X, B0Y, B0Z, B1X, B1Y, B1Z, OnB1X, OnB1Y, OnB1Z);
+		//B's ends onto A
+		VectorRegister4Float OnA0X, OnA0Y, OnA0Z, OnA1X, OnA1Y, OnA1Z;
+		ClosestPointOnSegment4(B0X, B0Y, B0Z, A0X, A0Y, A0Z, A1X, A1Y, A1Z, OnA0X, OnA0Y, OnA0Z);
+		ClosestPointOnSegment4(B1X, B1Y, B1Z, A0X, A0Y, A0Z, A1X, A1Y, A1Z, OnA1X, OnA1Y, OnA1Z);
+
+		//first candidate wins ties, same as the scalar version
+		VectorRegister4Float BestDist = DistSquared4(OnB0X, OnB0Y, OnB0Z, A0X, A0Y, A0Z);
+		VectorRegister4Float PAX = A0X, PAY = A0Y, PAZ = A0Z;
+		VectorRegister4Float PBX = OnB0X, PBY = OnB0Y, PBZ = OnB0Z;
+
+		const auto TakeIfCloser = [&](const VectorRegister4Float& Dist,
+			const VectorRegister4Float& AX, const VectorRegister4Float& AY, const VectorRegister4Float& AZ,
+			const VectorRegister4Float& BX, const VectorRegister4Float& BY, const VectorRegister4Float& BZ)
+		{
+			const VectorRegister4Float Closer = VectorCompareLT(Dist, BestDist);
+			BestDist = VectorSelect(Closer, Dist, BestDist);
+			PAX = VectorSelect(Closer, AX, PAX); PAY = VectorSelect(Closer, AY, PAY); PAZ = VectorSelect(Closer, AZ, PAZ);
+			PBX = VectorSelect(Closer, BX, PBX); PBY = VectorSelect(Closer, BY, PBY); PBZ = VectorSelect(Closer, BZ, PBZ);
+		};
+		TakeIfCloser(DistSquared4(OnB1X, OnB1Y, OnB1Z, A1X, A1Y, A1Z), A1X, A1Y, A1Z, OnB1X, OnB1Y, OnB1Z);
+		TakeIfCloser(DistSquared4(OnA0X, OnA0Y, OnA0Z, B0X, B0Y, B0Z), OnA0X, OnA0Y, OnA0Z, B0X, B0Y, B0Z);
+		TakeIfCloser(DistSquared4(OnA1X, OnA1Y, OnA1Z, B1X, B1Y, B1Z), OnA1X, OnA1Y, OnA1Z, B1X, B1Y, B1Z);
+
+		alignas(16) float OutDist[4], OutAX[4], OutAY[4], OutAZ[4], OutBX[4], OutBY[4], OutBZ[4];
+		VectorStoreAligned(BestDist, OutDist);
+		VectorStoreAligned(PAX, OutAX); VectorStoreAligned(PAY, OutAY); VectorStoreAligned(PAZ, OutAZ);
+		VectorStoreAligned(PBX, OutBX); VectorStoreAligned(PBY, OutBY); VectorStoreAligned(PBZ, OutBZ);
+
+		const int32 NumLanes = FMath::Min(4, Num - Index);
+		for (int32 Lane = 0; Lane < NumLanes; Lane++)
+		{
+			OutResult.DistSquared[Index + Lane] = OutDist[Lane];
+			OutResult.PointsOnA[Index + Lane] = FVector(OutAX[Lane], OutAY[Lane], OutAZ[Lane]);
+			OutResult.PointsOnB[Index + Lane] = FVector(OutBX[Lane], OutBY[Lane], OutBZ[Lane]);
+		}
+	}
+}
+
+/*Batched XYTurn: turn of B[i] from A[i], 4 lanes at a time, computed in float*/
+static FORCEINLINE void XYTurnBatch(const FDirectionSoA& A, const FDirectionSoA& B, TArray<FXYTurn>& OutTurns)
+{
+	using namespace StainMath;
+	
+	const int32 Num = A.Num();
+	OutTurns.SetNumUninitialized(Num);
+	
+	const VectorRegister4Float Zero = VectorZeroFloat();
+	const VectorRegister4Float One = VectorOneFloat();
+	const VectorRegister4Float MinusOne = VectorNegate(One);
+
+	for (int32 Index = 0; Index < Num; Index += 4)
+	{
+		const VectorRegister4Float AX = LoadLanes(A.X, Index);
+		const VectorRegister4Float AY = LoadLanes(A.Y, Index);
+		const VectorRegister4Float AZ = LoadLanes(A.Z, Index);
+		const VectorRegister4Float BX = LoadLanes(B.X, Index);
+		const VectorRegister4Float BY = LoadLanes(B.Y, Index);
+		const VectorRegister4Float BZ = LoadLanes(B.Z, Index);
+
+		//normalized in 3D like the scalar version, then only XY is compared
+		const VectorRegister4Float InvLengths = VectorMultiply(SafeInvLength4(AX, AY, AZ), SafeInvLength4(BX, BY, BZ));
+		const VectorRegister4Float DotXY = VectorMultiplyAdd(AY, BY, VectorMultiply(AX, BX));
+		const VectorRegister4Float Cos = VectorMin(VectorMax(VectorMultiply(DotXY, InvLengths), MinusOne), One);
+		
+		const VectorRegister4Float CrossZ = VectorSubtract(VectorMultiply(AX, BY), VectorMultiply(AY, BX));
+		const VectorRegister4Float Sign = VectorSelect(VectorCompareGT(CrossZ, Zero), One, VectorSelect(VectorCompareLT(CrossZ, Zero), MinusOne, Zero));
+		const VectorRegister4Float Sin = VectorMultiply(VectorSqrt(VectorMax(VectorSubtract(One, VectorMultiply(Cos, Cos)), Zero)), Sign);
+
+		alignas(16) float OutCos[4], OutSin[4];
+		VectorStoreAligned(Cos, OutCos);
+		VectorStoreAligned(Sin, OutSin);
+
+		const int32 NumLanes = FMath::Min(4, Num - Index);
+		for (int32 Lane = 0; Lane < NumLanes; Lane++)
+		{
+			OutTurns[Index + Lane].Cos = OutCos[Lane];
+			OutTurns[Index + Lane].Sin = OutSin[Lane];
+		}
+	}
+}
@@ -0,0 +1,174 @@
+﻿#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "Containers/List.h"
+#include "Actor/NavAwareEnhancedBase.h"
+#include "NavAwareBakedData.h"
+
+#include "NavAwareCacheSubsystem.generated.h"
+
+class ANavigationData;
+class ARecastNavMesh;
+
+/*
+ * Identifies one cached query: the poly FindEdges starts from, the recast tile it lies in,
+ * the cell of the origin inside the world grid, the radius and the classification settings of the agent
+ */
+struct FNavAwareCacheKey
+{
+	NavNodeRef Poly = INVALID_NAVNODEREF;
+	int32 TileIndex = INDEX_NONE;
+	FIntVector Cell = FIntVector::ZeroValue;
+	int32 Radius = 0;
+	uint32 SettingsHash = 0;
+
+	FORCEINLINE bool IsValid() const { return Poly != INVALID_NAVNODEREF; }
+
+	FORCEINLINE bool operator==(const FNavAwareCacheKey& Other) const
+	{
+		return Poly == Other.Poly && Cell == Other.Cell && Radius == Other.Radius && SettingsHash == Other.SettingsHash;
+	}
+
+	friend FORCEINLINE uint32 GetTypeHash(const FNavAwareCacheKey& Key)
+	{
+		return HashCombine(HashCombine(GetTypeHash(Key.Poly), GetTypeHash(Key.Cell)), HashCombine(GetTypeHash(Key.Radius), Key.SettingsHash));
+	}
+};
+
+typedef TDoubleLinkedList<FNavAwareCacheKey> FNavAwareCacheLruList;
+
+struct FNavAwareCacheEntry
+{
+	FNavAwareResult Result;
+
+	/*Every tile overlapped by the query, a rebuild of any of them drops this entry*/
+	TArray<int32> Tiles;
+	
+	/*Position in the use order, owned by the subsystem's LRU list*/
+	FNavAwareCacheLruList::TDoubleLinkedListNode* LruNode = nullptr;
+};
+
+/*
+ * Keeps classified wall chains, corner groups and entries of past queries, keyed by recast tile.
+ * Entries are dropped only for tiles touched by dirty areas or by OnNavigationGenerationFinished,
+ * so a repeat query in a static area becomes a lookup.
+ * Also maps the level's baked awareness data at begin play, see FNavAwareBakedData
+ */
+UCLASS(Config = Game)
+class AISENSINGEXTENTED_API UNavAwareCacheSubsystem : public UWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	virtual void OnWorldBeginPlay(UWorld& InWorld) override;
+	virtual void Deinitialize() override;
+
+	/*
+	 * Returns false when origin is not on navmesh. Costs one FindNearestPoly, make it once per query:
+	 * the key's poly is the one the pipeline starts FindEdges from
+	 */
+	bool MakeKey(const ARecastNavMesh* NavMesh, const FVector& Origin, float Radius, uint32 SettingsHash, FNavAwareCacheKey& OutKey) const;
+
+	/*
+	 * Copies a cached result into OutResult, returns false on a miss
+	 */
+	bool FindResult(const FNavAwareCacheKey& Key, FNavAwareResult& OutResult);
+
+	void StoreResult(const FNavAwareCacheKey& Key, const FNavAwareResult& Result, const ARecastNavMesh* NavMesh, const FVector& Origin, float Radius);
+
+	void InvalidateTiles(const TArray<int32>& Tiles);
+
+	/*
+	 * Looks Origin up in the baked data of this level, only hits when the data was baked with the same radius & settings
+	 * and the navmesh around it hasn't been dirtied since begin play
+	 */
+	bool FindBakedResult(const FVector& Origin, float Radius, uint32 SettingsHash, FNavAwareResult& OutResult) const;
+
+	UFUNCTION(BlueprintPure, Category= "NavAware|Cache")
+	bool HasBakedData() const { return BakedData.IsLoaded(); }
+
+	UFUNCTION(BlueprintCallable, Category= "NavAware|Cache")
+	void Flush();
+
+	UFUNCTION(BlueprintPure, Category= "NavAware|Cache")
+	int32 GetNumCachedResults() const { return CachedResults.Num(); }
+
+	/*
+	 * Holds navmesh rebuilds back while any awareness query reads tiles off the game thread.
+	 * The navigation system's build lock is a flag, so it is taken on the first acquire and given back on the last release.
+	 * Fails while a Custom lock this subsystem didn't add is set, that one is left alone and the query runs on the game thread
+	 */
+	bool AcquireNavBuildLock();
+	void ReleaseNavBuildLock();
+
+	FORCEINLINE float GetBakedOriginToleranceScale() const { return BakedOriginToleranceScale; }
+
+	/*Increased on every invalidation of this world's navmesh, incremental state of an older serial is thrown away*/
+	FORCEINLINE uint32 GetInvalidationSerial() const { return InvalidationSerial; }
+
+	/*
+	 * Sum of the serials of the tiles a query around Origin depends on, see StoreResult, plus the flush serial.
+	 * Serials only grow, so it changes exactly when one of those tiles was invalidated or the cache flushed;
+	 * a result computed across a change of it must not be stored
+	 */
+	uint32 GetAreaSerial(const ARecastNavMesh* NavMesh, const FVector& Origin, float Radius, int32 StartTile = INDEX_NONE) const;
+
+protected:
+	/*
+	 * Size of the grid cells origins are snapped to, queries from the same cell and poly share a result.
+	 * That result was found around another origin up to a cell away, its walls and entries near the edge of the radius
+	 * may differ from what a query right here would return. Smaller cells trade hits for accuracy
+	 */
+	UPROPERTY(EditAnywhere, Config, Category= "NavAware|Cache")
+	float CellSize = 100.f;
+
+	/*
+	 * A baked cell holds the result of one query from its bake origin, queries further from that origin
+	 * than this times the baked cell size miss the baked data and run the pipeline.
+	 * At 1 about every spot of a cell is served; "-run=NavAwareBenchmark -baked=<File>" reports the hit rate of each scale
+	 */
+	UPROPERTY(EditAnywhere, Config, Category= "NavAware|Cache", meta=(ClampMin = "0"))
+	float BakedOriginToleranceScale = 1.f;
+
+	/*Least recently used entry gets evicted when the cache is full*/
+	UPROPERTY(EditAnywhere, Config, Category= "NavAware|Cache")
+	int32 MaxCachedResults = 512;
+
+private:
+	UFUNCTION()
+	void OnNavigationGenerationFinished(ANavigationData* NavData);
+	
+	void OnNavigationDirtied(const FBox& DirtyBounds);
+
+	void RemoveEntry(const FNavAwareCacheKey& Key);
+
+	/*FindEdges only walks polys within radius, so tiles overlapped by the query box and the start poly's tile are all a query depends on*/
+	static void GatherQueryTiles(const ARecastNavMesh* NavMesh, const FVector& Origin, float Radius, int32 StartTile, TArray<int32>& OutTiles);
+	
+	void EvictLeastRecentlyUsed();
+
+	TMap<FNavAwareCacheKey, FNavAwareCacheEntry> CachedResults;
+
+	/*Keys of CachedResults, most recently used at the head, so eviction never scans the map*/
+	FNavAwareCacheLruList LruList;
+	TMultiMap<int32, FNavAwareCacheKey> KeysByTile;
+
+	/*Tiles dirtied since the last generation finished, dropped once more when it finishes*/
+	TSet<int32> PendingDirtyTiles;
+
+	FDelegateHandle NavigationDirtyHandle;
+
+	uint32 InvalidationSerial = 0;
+
+	/*Times each tile was invalidated, see GetAreaSerial*/
+	TMap<int32, uint32> TileSerials;
+	uint32 FlushSerial = 0;
+
+	int32 NumNavBuildLocks = 0;
+
+	FNavAwareBakedData BakedData;
+
+	/*Areas dirtied at runtime, baked cells overlapping them are not trusted anymore*/
+	TArray<FBox> BakedDirtyBounds;
+};
@@ -0,0 +1,78 @@
+﻿#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+
+#include "NavAwareSchedulerSubsystem.generated.h"
+
+class ANavAwareEnhancedBase;
+
+/*
+ * One pending awareness query, at most one per agent
+ */
+struct FNavAwareRequest
+{
+	TWeakObjectPtr<ANavAwareEnhancedBase> Agent;
+	float Urgency = 1.f;
+	float Radius = 550.f;
+	bool bDebug = false;
+	float Priority = 0.f;
+};
+
+/*
+ * Owns a priority queue of awareness requests from every ANavAwareEnhancedBase in the world,
+ * and each tick runs only as many of them as fit into FrameBudgetMs.
+ * Priority grows with caller urgency and staleness of the agent's last result, and shrinks with distance to the player
+ */
+UCLASS(Config = Game)
+class AISENSINGEXTENTED_API UNavAwareSchedulerSubsystem : public UTickableWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	virtual void Tick(float DeltaTime) override;
+	virtual TStatId GetStatId() const override;
+	virtual bool DoesSupportWorldType(const EWorldType::Type WorldType) const override;
+
+	/*
+	 * Queue an awareness query for given agent, if one is already queued its urgency is raised and parameters are replaced
+	 */
+	void EnqueueRequest(ANavAwareEnhancedBase* Agent, float Urgency, float Radius, bool bDebug);
+
+	void CancelRequest(const ANavAwareEnhancedBase* Agent);
+
+	UFUNCTION(BlueprintCallable, Category= "NavAware|Scheduler")
+	void SetFrameBudgetMs(float InBudgetMs) { FrameBudgetMs = FMath::Max(0.f, InBudgetMs); }
+
+	UFUNCTION(BlueprintPure, Category= "NavAware|Scheduler")
+	int32 GetNumPendingRequests() const { return PendingRequests.Num(); }
+
+protected:
+	/*Milliseconds of game thread time the scheduler may spend on queries per frame, at least one query runs every frame*/
+	UPROPERTY(EditAnywhere, Config, Category= "NavAware|Scheduler")
+	float FrameBudgetMs = 2.f;
+
+	/*Priority added per unit of caller supplied urgency*/
+	UPROPERTY(EditAnywhere, Config, Category= "NavAware|Scheduler")
+	float UrgencyWeight = 1.f;
+
+	/*Priority added per second since the agent's last result*/
+	UPROPERTY(EditAnywhere, Config, Category= "NavAware|Scheduler")
+	float StalenessWeight = 1.f;
+
+	/*Staleness larger than this won't add more priority*/
+	UPROPERTY(EditAnywhere, Config, Category= "NavAware|Scheduler")
+	float MaxStaleness = 5.f;
+
+	/*Priority removed per 1000 units of distance to the player*/
+	UPROPERTY(EditAnywhere, Config, Category= "NavAware|Scheduler")
+	float DistanceWeight = 1.f;
+
+private:
+	float CalcPriority(const FNavAwareRequest& Request, const FVector& PlayerLocation, bool bHasPlayer, double Now) const;
+	
+	TMap<TWeakObjectPtr<ANavAwareEnhancedBase>, FNavAwareRequest> PendingRequests;
+
+	/*Reused every tick as the binary heap*/
+	TArray<FNavAwareRequest> RequestHeap;
+};
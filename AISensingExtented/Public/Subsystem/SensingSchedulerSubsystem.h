@@ -0,0 +1,106 @@
+﻿#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "SensingPawnGrid.h"
+#include "SensingLineOfSightCache.h"
+
+#include "SensingSchedulerSubsystem.generated.h"
+
+class USensingComponentExtented;
+
+/*
+ * Next sensing pass of one registered sensor
+ */
+struct FSensingSlot
+{
+	TWeakObjectPtr<USensingComponentExtented> Sensor;
+	double NextUpdateTime = 0.0;
+
+	/*Registration this slot belongs to, slots of an earlier registration are dropped when popped*/
+	uint32 Registration = 0;
+};
+
+/*
+ * Drives the sensing passes of every USensingComponentExtented in the world instead of their own timers.
+ * Sensors are phased evenly across their interval, the interval grows with distance to the player and shrinks while alerted,
+ * and a frame runs passes only until MaxLineOfSightChecksPerFrame is reached, the rest go first next frame.
+ * Also owns the pawn grid sensors take their candidates from, and the line of sight answers they share
+ */
+UCLASS(Config = Game)
+class AISENSINGEXTENTED_API USensingSchedulerSubsystem : public UTickableWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	virtual void Initialize(FSubsystemCollectionBase& Collection) override;
+	virtual void Tick(float DeltaTime) override;
+	virtual TStatId GetStatId() const override;
+	virtual bool DoesSupportWorldType(const EWorldType::Type WorldType) const override;
+
+	void RegisterSensor(USensingComponentExtented* Sensor);
+	void UnregisterSensor(const USensingComponentExtented* Sensor);
+
+	UFUNCTION(BlueprintPure, Category= "Sensing|Scheduler")
+	int32 GetNumSensors() const { return Registrations.Num(); }
+
+	/*
+	 * Grid of every pawn in the world, built by the first caller of a frame
+	 */
+	const FSensingPawnGrid& GetPawnGrid();
+
+	FORCEINLINE FSensingLineOfSightCache& GetLineOfSightCache() { return LineOfSightCache; }
+
+	/*Line of sight checks done by the sensing passes of the last tick*/
+	UFUNCTION(BlueprintPure, Category= "Sensing|Scheduler")
+	int32 GetNumLineOfSightChecks() const { return LastLineOfSightChecks; }
+
+protected:
+	/*Passes stop for this frame once their line of sight checks reach this, at least one pass runs every frame*/
+	UPROPERTY(EditAnywhere, Config, Category= "Sensing|Scheduler")
+	int32 MaxLineOfSightChecksPerFrame = 64;
+
+	/*Sensors closer to the player than this run at their own SensingInterval*/
+	UPROPERTY(EditAnywhere, Config, Category= "Sensing|Scheduler")
+	float LODNearDistance = 1500.f;
+
+	/*Sensors this far from the player or further run at SensingInterval * FarIntervalScale, hearing sensors at most at HearingMaxSoundAge*/
+	UPROPERTY(EditAnywhere, Config, Category= "Sensing|Scheduler")
+	float LODFarDistance = 8000.f;
+
+	UPROPERTY(EditAnywhere, Config, Category= "Sensing|Scheduler")
+	float FarIntervalScale = 4.f;
+
+	/*Interval scale of a sensor that currently sees any pawn*/
+	UPROPERTY(EditAnywhere, Config, Category= "Sensing|Scheduler")
+	float AlertIntervalScale = 0.5f;
+
+	/*Cell size of the pawn grid, about the usual sight radius works best*/
+	UPROPERTY(EditAnywhere, Config, Category= "Sensing|Scheduler")
+	float PawnGridCellSize = 2000.f;
+
+	/*Observers & targets within the same cell of this size share line of sight answers*/
+	UPROPERTY(EditAnywhere, Config, Category= "Sensing|Scheduler")
+	float LineOfSightCacheCellSize = 100.f;
+
+	/*Seconds a shared line of sight answer stays valid*/
+	UPROPERTY(EditAnywhere, Config, Category= "Sensing|Scheduler")
+	float LineOfSightCacheTimeToLive = 0.2f;
+
+private:
+	float CalcInterval(const USensingComponentExtented& Sensor, const FVector& PlayerLocation, bool bHasPlayer) const;
+	
+	TMap<TWeakObjectPtr<USensingComponentExtented>, uint32> Registrations;
+	uint32 NumRegistrations = 0;
+
+	/*Min heap on NextUpdateTime*/
+	TArray<FSensingSlot> Slots;
+
+	int32 LastLineOfSightChecks = 0;
+
+	FSensingPawnGrid PawnGrid;
+	uint64 PawnGridFrame = MAX_uint64;
+
+	FSensingLineOfSightCache LineOfSightCache;
+	double LastLineOfSightCachePurge = 0.0;
+};
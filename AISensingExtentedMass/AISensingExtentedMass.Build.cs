@@ -0,0 +1,29 @@
+﻿using UnrealBuildTool;
+
+public class AISensingExtentedMass : ModuleRules
+{
+    public AISensingExtentedMass(ReadOnlyTargetRules Target) : base(Target)
+    {
+        PCHUsage = ModuleRules.PCHUsageMode.UseExplicitOrSharedPCHs;
+
+        PublicDependencyModuleNames.AddRange(
+            new string[]
+            {
+                "Core",
+                "MassEntity",
+                "MassSpawner"
+            }
+        );
+
+        PrivateDependencyModuleNames.AddRange(
+            new string[]
+            {
+                "CoreUObject",
+                "Engine",
+                "MassCommon",
+                "MassSignals",
+                "MassActors"
+            }
+        );
+    }
+}
\ No newline at end of file
@@ -0,0 +1,17 @@
+﻿#include "AISensingExtentedMass.h"
+
+#define LOCTEXT_NAMESPACE "FAISensingExtentedMassModule"
+
+void FAISensingExtentedMassModule::StartupModule()
+{
+    
+}
+
+void FAISensingExtentedMassModule::ShutdownModule()
+{
+    
+}
+
+#undef LOCTEXT_NAMESPACE
+    
+IMPLEMENT_MODULE(FAISensingExtentedMassModule, AISensingExtentedMass)
\ No newline at end of file
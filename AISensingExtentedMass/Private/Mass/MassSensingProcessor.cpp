@@ -0,0 +1,260 @@
+﻿#include "Mass/MassSensingProcessor.h"
+
+#include "MassCommonFragments.h"
+#include "MassCommonTypes.h"
+#include "MassExecutionContext.h"
+#include "MassEntityTemplateRegistry.h"
+#include "MassEntityUtils.h"
+#include "MassSignalSubsystem.h"
+#include "MassActorSubsystem.h"
+#include "EngineUtils.h"
+#include "GameFramework/Pawn.h"
+#include "GameFramework/Controller.h"
+#include "Components/PawnNoiseEmitterComponent.h"
+
+namespace UE::SensingExtented
+{
+	/*
+	 * Everything a pass needs to know about one pawn, read on the game thread before the workers start
+	 */
+	struct FSensingTarget
+	{
+		TWeakObjectPtr<APawn> Pawn;
+		
+		/*Only compared against agents' own actors on the workers, never dereferenced there*/
+		const AActor* Actor;
+		FVector Location;
+		FVector TargetLocation;
+		bool bIsPlayer;
+		
+		bool bHasNoiseEmitter;
+		double LocalNoiseTime;
+		float LocalNoiseVolume;
+		double RemoteNoiseTime;
+		float RemoteNoiseVolume;
+		FVector RemoteNoisePosition;
+	};
+
+	/*Same rule as UPawnSensingComponent::CanHear*/
+	static bool CanHear(const FMassSensingParameters& Sensing, const FVector& Eyes, const FVector& NoiseLocation, float Loudness, bool bFailedLineOfSight)
+	{
+		if (Loudness <= 0.f) return false;
+		
+		const float Threshold = (bFailedLineOfSight ? Sensing.HearingThreshold : Sensing.LOSHearingThreshold) * Loudness;
+		return FVector::DistSquared(Eyes, NoiseLocation) <= FMath::Square(Threshold);
+	}
+}
+
+
+UMassSensingProcessor::UMassSensingProcessor()
+	: EntityQuery(*this)
+{
+	ExecutionFlags = static_cast<int32>(EProcessorExecutionFlags::Server | EProcessorExecutionFlags::Standalone);
+	ExecutionOrder.ExecuteAfter.Add(UE::Mass::ProcessorGroupNames::Movement);
+	
+	//pawns are read in Execute, only the chunks go wide
+	bRequiresGameThreadExecution = true;
+}
+
+void UMassSensingProcessor::ConfigureQueries()
+{
+	EntityQuery.AddRequirement<FTransformFragment>(EMassFragmentAccess::ReadOnly);
+	EntityQuery.AddRequirement<FMassSensingFragment>(EMassFragmentAccess::ReadWrite);
+	EntityQuery.AddRequirement<FMassSensingStateFragment>(EMassFragmentAccess::ReadWrite);
+	EntityQuery.AddRequirement<FMassActorFragment>(EMassFragmentAccess::ReadOnly, EMassFragmentPresence::Optional);
+	EntityQuery.AddConstSharedRequirement<FMassSensingParameters>();
+	EntityQuery.AddSubsystemRequirement<UMassSignalSubsystem>(EMassFragmentAccess::ReadWrite);
+}
+
+void UMassSensingProcessor::Execute(FMassEntityManager& EntityManager, FMassExecutionContext& Context)
+{
+	using namespace UE::SensingExtented;
+	
+	UWorld* World = EntityManager.GetWorld();
+	if (World == nullptr) return;
+
+	TArray<FSensingTarget> Targets;
+	for (TActorIterator<APawn> It(World); It; ++It)
+	{
+		APawn* Pawn = *It;
+		if (!IsValid(Pawn)) continue;
+
+		FSensingTarget& Target = Targets.AddDefaulted_GetRef();
+		Target.Pawn = Pawn;
+		Target.Actor = Pawn;
+		Target.Location = Pawn->GetActorLocation();
+		Target.TargetLocation = Pawn->GetTargetLocation();
+		Target.bIsPlayer = Pawn->IsPlayerControlled();
+		
+		const UPawnNoiseEmitterComponent* NoiseEmitter = Pawn->GetPawnNoiseEmitterComponent();
+		Target.bHasNoiseEmitter = NoiseEmitter != nullptr;
+		if (NoiseEmitter)
+		{
+			Target.LocalNoiseTime = NoiseEmitter->GetLastNoiseTime(true);
+			Target.LocalNoiseVolume = NoiseEmitter->GetLastNoiseVolume(true);
+			Target.RemoteNoiseTime = NoiseEmitter->GetLastNoiseTime(false);
+			Target.RemoteNoiseVolume = NoiseEmitter->GetLastNoiseVolume(false);
+			Target.RemoteNoisePosition = NoiseEmitter->LastRemoteNoisePosition;
+		}
+	}
+
+	const float DeltaTime = Context.GetDeltaTimeSeconds();
+	const double Now = World->GetTimeSeconds();
+
+	//chunks append their changes once each, under the lock
+	FCriticalSection ChangesSection;
+	TArray<FMassEntityHandle> NewlySeen;
+	TArray<FMassEntityHandle> Unseen;
+	TArray<FMassEntityHandle> Heard;
+	
+	EntityQuery.ParallelForEachEntityChunk(EntityManager, Context, [&](FMassExecutionContext& ChunkContext)
+	{
+		const TConstArrayView<FTransformFragment> Transforms = ChunkContext.GetFragmentView<FTransformFragment>();
+		const TArrayView<FMassSensingFragment> Timers = ChunkContext.GetMutableFragmentView<FMassSensingFragment>();
+		const FMassSensingParameters& Sensing = ChunkContext.GetConstSharedFragment<FMassSensingParameters>();
+		const TArrayView<FMassSensingStateFragment> States = ChunkContext.GetMutableFragmentView<FMassSensingStateFragment>();
+		//empty for agents without an actor representation
+		const TConstArrayView<FMassActorFragment> Actors = ChunkContext.GetFragmentView<FMassActorFragment>();
+
+		//ignored actors are swapped per trace, the rest of the params stays
+		FCollisionQueryParams Params(SCENE_QUERY_STAT(MassSensingLineOfSight), true);
+
+		TArray<FMassEntityHandle, TInlineAllocator<32>> ChunkNewlySeen;
+		TArray<FMassEntityHandle, TInlineAllocator<32>> ChunkUnseen;
+		TArray<FMassEntityHandle, TInlineAllocator<32>> ChunkHeard;
+		TArray<TWeakObjectPtr<APawn>, TInlineAllocator<2>> SeenThisPass;
+		
+		for (int32 EntityIndex = 0; EntityIndex < ChunkContext.GetNumEntities(); EntityIndex++)
+		{
+			const FMassEntityHandle Entity = ChunkContext.GetEntity(EntityIndex);
+			FMassSensingFragment& Timer = Timers[EntityIndex];
+			
+			FMassSensingStateFragment& State = States[EntityIndex];
+			
+			//agents spawned together would sense on the same frame, golden ratio spreads them evenly over the interval
+			if (!Timer.bPhaseSeeded)
+			{
+				Timer.TimeUntilSense = Sensing.SensingInterval * static_cast<float>(FMath::Frac(Entity.Index * 0.6180339887));
+				Timer.bPhaseSeeded = true;
+				
+				//a new agent hears what is still recent, not every noise since the world began
+				State.LastSenseTime = Now - Sensing.HearingMaxSoundAge;
+			}
+			
+			Timer.TimeUntilSense -= DeltaTime;
+			if (Timer.TimeUntilSense > 0.f) continue;
+			Timer.TimeUntilSense += FMath::Max(Sensing.SensingInterval, DeltaTime);
+			
+			const FTransform& Transform = Transforms[EntityIndex].GetTransform();
+			const FVector Eyes = Transform.GetLocation() + FVector(0.f, 0.f, Sensing.EyeHeight);
+			const FVector Forward = Transform.GetRotation().GetForwardVector();
+			
+			//the agent's own pawn, when it has one: never a target, and the eyes sit inside its capsule
+			const AActor* AgentActor = Actors.Num() > 0 ? Actors[EntityIndex].Get() : nullptr;
+			
+			SeenThisPass.Reset();
+			State.HeardNoises.Reset();
+			const double OldestNoiseTime = FMath::Max(State.LastSenseTime, Now - Sensing.HearingMaxSoundAge);
+			
+			for (const FSensingTarget& Target : Targets)
+			{
+				if (Target.Actor == AgentActor || (Sensing.bOnlySensePlayers && !Target.bIsPlayer)) continue;
+				
+				// Visibility checks
+				bool bFailedLineOfSight = false;
+				if (Sensing.bSeePawns)
+				{
+					const FVector ToTarget = Target.Location - Eyes;
+					const double DistSquared = ToTarget.SizeSquared();
+					if (DistSquared <= FMath::Square(Sensing.SightRadius)
+						&& FVector::DotProduct(ToTarget.GetSafeNormal(), Forward) >= Sensing.PeripheralVisionCosine)
+					{
+						Params.ClearIgnoredActors();
+						Params.AddIgnoredActor(AgentActor);
+						Params.AddIgnoredActor(Target.Pawn.Get());
+						if (!World->LineTraceTestByChannel(Eyes, Target.TargetLocation, ECC_Visibility, Params))
+						{
+							SeenThisPass.Add(Target.Pawn);
+							
+							// No need to 'hear' something if you've already seen it!
+							continue;
+						}
+						bFailedLineOfSight = true;
+					}
+				}
+
+				// Sound checks, local noise first like the component
+				if (!Sensing.bHearNoises || !Target.bHasNoiseEmitter) continue;
+				
+				if (Target.LocalNoiseTime > OldestNoiseTime && CanHear(Sensing, Eyes, Target.Location, Target.LocalNoiseVolume, bFailedLineOfSight))
+				{
+					State.HeardNoises.Add({Target.Pawn, Target.Location});
+				}
+				else if (Target.RemoteNoiseTime > OldestNoiseTime && CanHear(Sensing, Eyes, Target.RemoteNoisePosition, Target.RemoteNoiseVolume, false))
+				{
+					State.HeardNoises.Add({Target.Pawn, Target.RemoteNoisePosition});
+				}
+			}
+
+			//only the changes leave the pass, same as the UnSeePawn transition of the component
+			bool bSeesNew = false;
+			for (const TWeakObjectPtr<APawn>& Pawn : SeenThisPass)
+			{
+				bSeesNew |= !State.SeenPawns.Contains(Pawn);
+			}
+			bool bLostAny = false;
+			for (const TWeakObjectPtr<APawn>& Pawn : State.SeenPawns)
+			{
+				bLostAny |= !SeenThisPass.Contains(Pawn);
+			}
+			
+			if (bSeesNew)
+			{
+				ChunkNewlySeen.Add(Entity);
+			}
+			if (bLostAny)
+			{
+				ChunkUnseen.Add(Entity);
+			}
+			if (State.HeardNoises.Num() > 0)
+			{
+				ChunkHeard.Add(Entity);
+			}
+			
+			State.SeenPawns = SeenThisPass;
+			State.LastSenseTime = Now;
+		}
+
+		if (ChunkNewlySeen.Num() > 0 || ChunkUnseen.Num() > 0 || ChunkHeard.Num() > 0)
+		{
+			FScopeLock Lock(&ChangesSection);
+			NewlySeen.Append(ChunkNewlySeen);
+			Unseen.Append(ChunkUnseen);
+			Heard.Append(ChunkHeard);
+		}
+	});
+
+	UMassSignalSubsystem& SignalSubsystem = Context.GetMutableSubsystemChecked<UMassSignalSubsystem>();
+	if (NewlySeen.Num() > 0)
+	{
+		SignalSubsystem.SignalEntities(Signals::PawnSeen, NewlySeen);
+	}
+	if (Unseen.Num() > 0)
+	{
+		SignalSubsystem.SignalEntities(Signals::PawnUnseen, Unseen);
+	}
+	if (Heard.Num() > 0)
+	{
+		SignalSubsystem.SignalEntities(Signals::NoiseHeard, Heard);
+	}
+}
+
+void UMassSensingTrait::BuildTemplate(FMassEntityTemplateBuildContext& BuildContext, const UWorld& World) const
+{
+	BuildContext.RequireFragment<FTransformFragment>();
+	BuildContext.AddFragment<FMassSensingFragment>();
+	BuildContext.AddFragment<FMassSensingStateFragment>();
+	
+	FMassEntityManager& EntityManager = UE::Mass::Utils::GetEntityManagerChecked(World);
+	BuildContext.AddConstSharedFragment(EntityManager.GetOrCreateConstSharedFragment(Sensing));
+}
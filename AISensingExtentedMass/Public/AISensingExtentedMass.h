@@ -0,0 +1,14 @@
+﻿#pragma once
+
+#include "CoreMinimal.h"
+#include "Modules/ModuleManager.h"
+
+/*
+ * Crowd-scale sensing on Mass entities. Kept apart from AISensingExtented so only projects using it need the MassGameplay plugin
+ */
+class FAISensingExtentedMassModule : public IModuleInterface
+{
+public:
+    virtual void StartupModule() override;
+    virtual void ShutdownModule() override;
+};
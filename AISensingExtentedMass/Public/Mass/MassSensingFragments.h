@@ -0,0 +1,118 @@
+﻿#pragma once
+
+#include "CoreMinimal.h"
+#include "MassEntityTypes.h"
+#include "MassSensingFragments.generated.h"
+
+class APawn;
+
+/*
+ * Sensing settings of crowd agents, the counterpart of UPawnSensingComponent's properties.
+ * Shared by every agent of one entity config
+ */
+USTRUCT()
+struct AISENSINGEXTENTEDMASS_API FMassSensingParameters : public FMassConstSharedFragment
+{
+	GENERATED_BODY()
+
+	UPROPERTY(EditAnywhere, Category= "AI")
+	float SightRadius = 5000.f;
+
+	/*Hearing range of a noise at loudness 1 when the noise source can't be seen*/
+	UPROPERTY(EditAnywhere, Category= "AI")
+	float HearingThreshold = 1400.f;
+
+	/*Hearing range of a noise at loudness 1 when the noise source can be seen*/
+	UPROPERTY(EditAnywhere, Category= "AI")
+	float LOSHearingThreshold = 2800.f;
+
+	/*Cosine of the half angle of the vision cone*/
+	UPROPERTY(EditAnywhere, Category= "AI")
+	float PeripheralVisionCosine = 0.f;
+
+	/*Height of the eyes above the entity's location*/
+	UPROPERTY(EditAnywhere, Category= "AI")
+	float EyeHeight = 64.f;
+
+	UPROPERTY(EditAnywhere, Category= "AI")
+	float SensingInterval = 0.5f;
+
+	/*Noises older than this aren't heard, also bounds what the first pass of a new agent hears*/
+	UPROPERTY(EditAnywhere, Category= "AI")
+	float HearingMaxSoundAge = 1.f;
+
+	UPROPERTY(EditAnywhere, Category= "AI")
+	bool bSeePawns = true;
+
+	UPROPERTY(EditAnywhere, Category= "AI")
+	bool bHearNoises = true;
+
+	UPROPERTY(EditAnywhere, Category= "AI")
+	bool bOnlySensePlayers = true;
+};
+
+/*
+ * Sensing timer of one crowd agent
+ */
+USTRUCT()
+struct AISENSINGEXTENTEDMASS_API FMassSensingFragment : public FMassFragment
+{
+	GENERATED_BODY()
+
+	/*Counts down to the next sensing pass of this agent*/
+	float TimeUntilSense = 0.f;
+
+	/*Set once the first pass has spread this agent's timer over the interval*/
+	bool bPhaseSeeded = false;
+};
+
+/*
+ * One noise heard by a crowd agent
+ */
+struct FMassHeardNoise
+{
+	TWeakObjectPtr<APawn> Pawn;
+	FVector Location = FVector::ZeroVector;
+};
+
+/*
+ * What one crowd agent senses, kept between passes to tell the changes apart
+ */
+USTRUCT()
+struct AISENSINGEXTENTEDMASS_API FMassSensingStateFragment : public FMassFragment
+{
+	GENERATED_BODY()
+
+	TArray<TWeakObjectPtr<APawn>, TInlineAllocator<2>> SeenPawns;
+
+	/*
+	 * Every noise heard by the last pass, one per pawn like OnHearNoise of the component.
+	 * The agent gets a single SensingNoiseHeard per pass, its handler walks this array
+	 */
+	TArray<FMassHeardNoise, TInlineAllocator<1>> HeardNoises;
+
+	/*World time of the last pass, noises older than it are heard already. Seeded to Now - HearingMaxSoundAge on the first pass*/
+	double LastSenseTime = 0.0;
+};
+
+//the seen and heard sets are arrays, copied by hand on archetype moves
+template<>
+struct TMassFragmentTraits<FMassSensingStateFragment> final
+{
+	enum
+	{
+		AuthorAcceptsItsNotTriviallyCopyable = true
+	};
+};
+
+namespace UE::SensingExtented::Signals
+{
+	/*A pass saw a pawn this agent didn't see in the pass before*/
+	const FName PawnSeen = FName(TEXT("SensingPawnSeen"));
+	
+	/*A pawn seen in the pass before isn't seen anymore, the UnSeePawn of crowd agents*/
+	const FName PawnUnseen = FName(TEXT("SensingPawnUnseen"));
+	
+	/*A pass heard one or more noises, see FMassSensingStateFragment::HeardNoises*/
+	const FName NoiseHeard = FName(TEXT("SensingNoiseHeard"));
+}
@@ -0,0 +1,43 @@
+﻿#pragma once
+
+#include "CoreMinimal.h"
+#include "MassProcessor.h"
+#include "MassEntityTraitBase.h"
+#include "Mass/MassSensingFragments.h"
+#include "MassSensingProcessor.generated.h"
+
+/*
+ * Runs the see/unsee/hear logic of USensingComponentExtented over crowd agents.
+ * Pawns are snapshotted once on the game thread, then agents are sensed with parallel chunk iteration,
+ * and only the changes go out, as one batched signal per kind
+ */
+UCLASS()
+class AISENSINGEXTENTEDMASS_API UMassSensingProcessor : public UMassProcessor
+{
+	GENERATED_BODY()
+
+public:
+	UMassSensingProcessor();
+
+protected:
+	virtual void ConfigureQueries() override;
+	virtual void Execute(FMassEntityManager& EntityManager, FMassExecutionContext& Context) override;
+
+private:
+	FMassEntityQuery EntityQuery;
+};
+
+/*
+ * Gives an entity config sensing like a USensingComponentExtented
+ */
+UCLASS(meta = (DisplayName = "Sensing Extented"))
+class AISENSINGEXTENTEDMASS_API UMassSensingTrait : public UMassEntityTraitBase
+{
+	GENERATED_BODY()
+
+protected:
+	virtual void BuildTemplate(FMassEntityTemplateBuildContext& BuildContext, const UWorld& World) const override;
+
+	UPROPERTY(EditAnywhere, Category= "Sensing")
+	FMassSensingParameters Sensing;
+};